@@ -0,0 +1,431 @@
+// Email: sone0149@gmail.com
+
+
+#ifndef COMPACTMYCONTAINER_HPP
+#define COMPACTMYCONTAINER_HPP
+
+#include "MyContainer.hpp"
+
+#include <variant>
+
+namespace ariel {
+
+/**
+ * @brief An integer container storing its elements in frame-of-reference encoding
+ *
+ * Every element is stored as its offset from a common base value, in the
+ * narrowest of 8, 16, 32 or 64-bit lanes that covers the range of the
+ * stored values, so a container of ints between 0 and 1000 takes 2 bytes
+ * per element instead of 4. Adding a value outside the current range moves
+ * the base or widens the lanes; the base is placed in the middle of the
+ * spare room of the lane so that growing ranges do not re-encode on every
+ * add. Supports the same add/remove/size operations and the same six
+ * iteration orders as MyContainer. Iterators decode elements on the fly and
+ * therefore yield values rather than references; sorted orders sort a copy
+ * of the (narrow) offsets rather than of the elements.
+ *
+ * @tparam T An integral element type
+ */
+template <typename T>
+class CompactMyContainer {
+    static_assert(std::is_integral<T>::value && !std::is_same<T, bool>::value,
+                  "CompactMyContainer stores integers");
+
+public:
+    /// Encoded offsets; the alternative in use is the current lane width
+    using lanes_type = std::variant<std::vector<uint8_t>, std::vector<uint16_t>,
+                                    std::vector<uint32_t>, std::vector<uint64_t>>;
+
+    template <typename Policy>
+    class Iterator;
+
+    using AscendingIterator = Iterator<OrderPolicy<Order::Ascending>>;
+    using DescendingIterator = Iterator<OrderPolicy<Order::Descending>>;
+    using SideCrossIterator = Iterator<OrderPolicy<Order::SideCross>>;
+    using ReverseIterator = Iterator<OrderPolicy<Order::Reverse>>;
+    using OrderIterator = Iterator<OrderPolicy<Order::Normal>>;
+    using MiddleOutIterator = Iterator<OrderPolicy<Order::MiddleOut>>;
+
+private:
+    using unsigned_type = std::make_unsigned_t<T>;
+
+    /// Index of the widest lane needed for T (full range, no base shifting)
+    static constexpr size_t widest_lane = sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3;
+
+    lanes_type lanes;  ///< Offsets from base, in insertion order
+    T base = 0;        ///< Value encoded by offset 0
+    T low = 0;         ///< Lower bound of the stored values (if any)
+    T high = 0;        ///< Upper bound of the stored values (if any)
+    size_t reencodes = 0;  ///< Number of times every element was re-encoded
+
+    /**
+     * @brief Largest offset a lane can hold
+     * @param lane Lane index (0: 8 bits, ..., 3: 64 bits)
+     * @return The maximum offset, capped to the range of T
+     */
+    static unsigned_type lane_max(size_t lane) {
+        if (lane >= widest_lane) {
+            return std::numeric_limits<unsigned_type>::max();
+        }
+        return static_cast<unsigned_type>((uint64_t(1) << (8u << lane)) - 1);
+    }
+
+    /**
+     * @brief Check whether a value can be encoded with the current base and lanes
+     * @param value The value
+     * @return true if base <= value and the offset fits the lane
+     */
+    bool fits(T value) const {
+        return value >= base && offset_of(value) <= lane_max(lanes.index());
+    }
+
+    /**
+     * @brief Offset of a value from the base (the value must not be below the base)
+     */
+    unsigned_type offset_of(T value) const {
+        return static_cast<unsigned_type>(static_cast<unsigned_type>(value) - static_cast<unsigned_type>(base));
+    }
+
+    /**
+     * @brief Decode an offset
+     * @param offset Offset from the base
+     * @return The encoded value
+     */
+    template <typename Lane>
+    T decode(Lane offset) const {
+        return static_cast<T>(static_cast<unsigned_type>(static_cast<unsigned_type>(base) + offset));
+    }
+
+    /**
+     * @brief Choose the lanes and base for a new value range and re-encode every element
+     * @param new_low Lower bound of the values to represent
+     * @param new_high Upper bound of the values to represent
+     */
+    void reencode(T new_low, T new_high) {
+        unsigned_type range = static_cast<unsigned_type>(static_cast<unsigned_type>(new_high) -
+                                                         static_cast<unsigned_type>(new_low));
+        size_t lane = 0;
+        while (lane < widest_lane && lane_max(lane) < range) {
+            ++lane;
+        }
+        T new_base = std::numeric_limits<T>::lowest();
+        if (lane < widest_lane) {
+            unsigned_type below = static_cast<unsigned_type>(static_cast<unsigned_type>(new_low) -
+                                                             static_cast<unsigned_type>(new_base));
+            unsigned_type slack = std::min<unsigned_type>((lane_max(lane) - range) / 2, below);
+            new_base = static_cast<T>(static_cast<unsigned_type>(static_cast<unsigned_type>(new_low) - slack));
+        }
+
+        lanes_type encoded = make_lanes(lane);
+        std::visit([&](const auto& from, auto& to) {
+            using lane_type = typename std::decay_t<decltype(to)>::value_type;
+            to.reserve(from.size());
+            for (auto offset : from) {
+                T value = decode(offset);
+                to.push_back(static_cast<lane_type>(static_cast<unsigned_type>(value) -
+                                                    static_cast<unsigned_type>(new_base)));
+            }
+        }, lanes, encoded);
+        lanes.swap(encoded);
+        base = new_base;
+        ++reencodes;
+    }
+
+    /**
+     * @brief Create empty lanes of the given width
+     * @param lane Lane index (0: 8 bits, ..., 3: 64 bits)
+     */
+    static lanes_type make_lanes(size_t lane) {
+        switch (lane) {
+            case 0: return lanes_type(std::in_place_index<0>);
+            case 1: return lanes_type(std::in_place_index<1>);
+            case 2: return lanes_type(std::in_place_index<2>);
+            default: return lanes_type(std::in_place_index<3>);
+        }
+    }
+
+public:
+    /**
+     * @brief Default constructor - creates an empty container
+     */
+    CompactMyContainer() = default;
+
+    /**
+     * @brief Add an element to the container
+     * @param element The element to add
+     */
+    void add(T element) {
+        if (size() == 0) {
+            low = high = element;
+        }
+        T new_low = std::min(low, element);
+        T new_high = std::max(high, element);
+        if (!fits(element)) {
+            reencode(new_low, new_high);
+        }
+        low = new_low;
+        high = new_high;
+        unsigned_type offset = offset_of(element);
+        std::visit([offset](auto& offsets) {
+            using lane_type = typename std::decay_t<decltype(offsets)>::value_type;
+            offsets.push_back(static_cast<lane_type>(offset));
+        }, lanes);
+    }
+
+    /**
+     * @brief Remove all instances of an element from the container
+     * @param element The element to remove
+     * @throws std::runtime_error if the element is not found
+     */
+    void remove(T element) {
+        size_t initial_size = size();
+        if (initial_size > 0 && fits(element)) {
+            unsigned_type offset = offset_of(element);
+            std::visit([offset](auto& offsets) {
+                using lane_type = typename std::decay_t<decltype(offsets)>::value_type;
+                offsets.erase(std::remove(offsets.begin(), offsets.end(), static_cast<lane_type>(offset)),
+                              offsets.end());
+            }, lanes);
+        }
+
+        if (size() == initial_size) {
+            throw std::runtime_error("Element not found in container");
+        }
+    }
+
+    /**
+     * @brief Get the number of elements in the container
+     * @return The size of the container
+     */
+    size_t size() const {
+        return std::visit([](const auto& offsets) { return offsets.size(); }, lanes);
+    }
+
+    /**
+     * @brief Get the number of bytes each element currently occupies
+     * @return The lane width: 1, 2, 4 or 8
+     */
+    size_t bytes_per_element() const {
+        return std::visit([](const auto& offsets) { return sizeof(offsets[0]); }, lanes);
+    }
+
+    /**
+     * @brief Get the number of times the elements were re-encoded
+     *
+     * Each re-encoding (a moved base or wider lanes) costs O(n); the spare
+     * room left around the stored range keeps them rare.
+     *
+     * @return The number of re-encodings since construction
+     */
+    size_t reencode_count() const {
+        return reencodes;
+    }
+
+    /**
+     * @brief Decode the elements of an iteration order into a buffer
+     *
+     * The order is dispatched once and every order decodes in its own loop.
+     * Insertion, ascending, reverse and descending orders are a widening add
+     * over a contiguous lane, read forwards or backwards, which compilers
+     * turn into SIMD unpack instructions; side cross and middle out
+     * interleave two such streams. Insertion-based orders read the lane in
+     * place, sorted ones a sorted copy of it.
+     *
+     * @param order The iteration order to materialize
+     * @param out Random access iterator to a buffer of at least size() elements
+     */
+    template <typename RandomIt>
+    void materialize(Order order, RandomIt out) const {
+        std::visit([&](const auto& offsets) {
+            using lane_type = typename std::decay_t<decltype(offsets)>::value_type;
+            size_t n = offsets.size();
+            if (n == 0) {
+                return;
+            }
+            unsigned_type first = static_cast<unsigned_type>(base);
+            auto widen = [first](lane_type offset) {
+                return static_cast<T>(static_cast<unsigned_type>(first + offset));
+            };
+            std::vector<lane_type> sorted;
+            const lane_type* lane = offsets.data();
+            if (detail::is_sorted_order(order)) {
+                sorted = offsets;
+                std::sort(sorted.begin(), sorted.end());
+                lane = sorted.data();
+            }
+            size_t mid = n / 2;
+            switch (order) {
+                case Order::Normal:
+                case Order::Ascending:
+                    for (size_t pos = 0; pos < n; ++pos) {
+                        out[pos] = widen(lane[pos]);
+                    }
+                    break;
+                case Order::Reverse:
+                case Order::Descending:
+                    for (size_t pos = 0; pos < n; ++pos) {
+                        out[pos] = widen(lane[n - 1 - pos]);
+                    }
+                    break;
+                case Order::SideCross:
+                    for (size_t k = 0; k < mid; ++k) {
+                        out[2 * k] = widen(lane[k]);
+                        out[2 * k + 1] = widen(lane[n - 1 - k]);
+                    }
+                    if (n % 2 != 0) {
+                        out[n - 1] = widen(lane[mid]);
+                    }
+                    break;
+                case Order::MiddleOut:
+                    out[0] = widen(lane[mid]);
+                    for (size_t k = 1; 2 * k < n; ++k) {
+                        out[2 * k - 1] = widen(lane[mid - k]);
+                        out[2 * k] = widen(lane[mid + k]);
+                    }
+                    if (n % 2 == 0) {
+                        out[n - 1] = widen(lane[0]);
+                    }
+                    break;
+            }
+        }, lanes);
+    }
+
+    /**
+     * @brief Output stream operator for printing the container
+     * @param os The output stream
+     * @param container The container to print
+     * @return The output stream
+     */
+    friend std::ostream& operator<<(std::ostream& os, const CompactMyContainer& container) {
+        os << "[";
+        size_t i = 0;
+        size_t n = container.size();
+        for (auto it = container.begin(); it != container.end(); ++it, ++i) {
+            os << *it;
+            if (i < n - 1) {
+                os << ", ";
+            }
+        }
+        os << "]";
+        return os;
+    }
+
+    OrderIterator begin() const { return OrderIterator(*this); }
+    OrderIterator end() const { return OrderIterator(*this, true); }
+
+    AscendingIterator begin_ascending_order() const { return AscendingIterator(*this); }
+    AscendingIterator end_ascending_order() const { return AscendingIterator(*this, true); }
+
+    DescendingIterator begin_descending_order() const { return DescendingIterator(*this); }
+    DescendingIterator end_descending_order() const { return DescendingIterator(*this, true); }
+
+    SideCrossIterator begin_side_cross_order() const { return SideCrossIterator(*this); }
+    SideCrossIterator end_side_cross_order() const { return SideCrossIterator(*this, true); }
+
+    ReverseIterator begin_reverse_order() const { return ReverseIterator(*this); }
+    ReverseIterator end_reverse_order() const { return ReverseIterator(*this, true); }
+
+    OrderIterator begin_order() const { return OrderIterator(*this); }
+    OrderIterator end_order() const { return OrderIterator(*this, true); }
+
+    MiddleOutIterator begin_middle_out_order() const { return MiddleOutIterator(*this); }
+    MiddleOutIterator end_middle_out_order() const { return MiddleOutIterator(*this, true); }
+
+    template <typename Policy>
+    Iterator<Policy> begin_custom_order() const { return Iterator<Policy>(*this); }
+    template <typename Policy>
+    Iterator<Policy> end_custom_order() const { return Iterator<Policy>(*this, true); }
+
+    /**
+     * @brief Iterator decoding elements on the fly
+     *
+     * Insertion-based orders read the container's lanes directly; sorted
+     * orders sort a private copy of the offsets on construction (not at all
+     * for end iterators). Iterators are invalidated by mutations.
+     *
+     * @tparam Policy Ordering policy (see OrderPolicy)
+     */
+    template <typename Policy>
+    class Iterator {
+    private:
+        const CompactMyContainer* container;  ///< Container being traversed
+        lanes_type sorted;                    ///< Offsets in ascending order (sorted orders only)
+        size_t count;                         ///< Number of elements
+        size_t index;                         ///< Current position in iteration
+
+    public:
+        // Elements are decoded into prvalues, so the iterator cannot meet the
+        // forward iterator requirement that reference be a true reference
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = T;
+
+        /**
+         * @brief Construct an iterator
+         * @param container The container to iterate over
+         * @param end If true, creates an end iterator
+         */
+        Iterator(const CompactMyContainer& container, bool end = false)
+            : container(&container), count(container.size()), index(end ? count : 0) {
+            if constexpr (Policy::sorted) {
+                if (!end) {
+                    sorted = container.lanes;
+                    std::visit([](auto& offsets) { std::sort(offsets.begin(), offsets.end()); }, sorted);
+                }
+            }
+        }
+
+        /**
+         * @brief Dereference operator
+         * @return The decoded current element
+         */
+        T operator*() const {
+            size_t source = Policy::index(count, index);
+            const lanes_type& offsets = Policy::sorted ? sorted : container->lanes;
+            return std::visit([&](const auto& lane) { return container->decode(lane[source]); }, offsets);
+        }
+
+        /**
+         * @brief Pre-increment operator
+         * @return Reference to this iterator after increment
+         */
+        Iterator& operator++() {
+            ++index;
+            return *this;
+        }
+
+        /**
+         * @brief Post-increment operator
+         * @return Copy of iterator before increment
+         */
+        Iterator operator++(int) {
+            Iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        /**
+         * @brief Equality comparison
+         * @param other Iterator to compare with
+         * @return true if iterators point to same position
+         */
+        bool operator==(const Iterator& other) const {
+            return index == other.index;
+        }
+
+        /**
+         * @brief Inequality comparison
+         * @param other Iterator to compare with
+         * @return true if iterators point to different positions
+         */
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+    };
+};
+
+} // namespace ariel
+
+#endif // COMPACTMYCONTAINER_HPP
@@ -8,9 +8,1746 @@
 #include <algorithm>
 #include <stdexcept>
 #include <iostream>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <exception>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <new>
+#include <type_traits>
+#include <optional>
+#include <memory>
+#include <utility>
+#include <memory_resource>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <atomic>
+
+#if defined(__cpp_lib_constexpr_vector) && defined(__cpp_lib_constexpr_algorithms) && \
+    defined(__cpp_constexpr_dynamic_alloc)
+/// Expands to constexpr in C++20 builds, where vectors and sorting are constexpr
+#define ARIEL_CONSTEXPR20 constexpr
+#define ARIEL_HAS_CONSTEXPR_CONTAINER 1
+#else
+#define ARIEL_CONSTEXPR20
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+/// Hints the CPU to start loading the cache line holding an address
+#define ARIEL_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define ARIEL_PREFETCH(address) ((void)(address))
+#endif
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define ARIEL_HAS_COROUTINES 1
+#endif
 
 namespace ariel {
 
+/**
+ * @brief The six iteration orders supported by MyContainer
+ */
+enum class Order {
+    Normal,      ///< Insertion order
+    Ascending,   ///< Sorted ascending
+    Descending,  ///< Sorted descending
+    SideCross,   ///< Smallest, largest, second smallest, second largest, ...
+    Reverse,     ///< Reverse insertion order
+    MiddleOut    ///< Middle element first, then alternating left and right
+};
+
+/**
+ * @brief Describes how bulk operations should be executed
+ *
+ * The work is split into at most `threads` contiguous chunks of at least
+ * `grain` elements each, so small inputs stay on the calling thread.
+ */
+struct ExecutionPolicy {
+    unsigned threads;  ///< Maximum number of threads (0 = hardware concurrency)
+    size_t grain;      ///< Minimum number of elements per thread
+};
+
+/// Run everything on the calling thread
+inline constexpr ExecutionPolicy seq{1, 0};
+
+/// Use all hardware threads for inputs large enough to benefit
+inline constexpr ExecutionPolicy par{0, 1 << 15};
+
+namespace detail {
+
+/**
+ * @brief Portable std::is_constant_evaluated()
+ * @return true during constant evaluation (always false before C++20)
+ */
+constexpr bool is_constant_evaluated() noexcept {
+#ifdef __cpp_lib_is_constant_evaluated
+    return std::is_constant_evaluated();
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Lock guard over an optional mutex
+ *
+ * A literal type, so it can appear in functions that are constexpr in C++20
+ * builds; the mutex is never present during constant evaluation.
+ */
+class OptionalLock {
+private:
+    std::mutex* mutex;  ///< Locked mutex, or null
+
+public:
+    /**
+     * @brief Lock the mutex, if any
+     * @param m Mutex to lock (may be null)
+     */
+    constexpr explicit OptionalLock(std::mutex* m) : mutex(m) {
+        if (mutex) {
+            mutex->lock();
+        }
+    }
+
+    OptionalLock(const OptionalLock&) = delete;
+    OptionalLock& operator=(const OptionalLock&) = delete;
+
+    /**
+     * @brief Unlock early
+     */
+    constexpr void unlock() {
+        if (mutex) {
+            std::exchange(mutex, nullptr)->unlock();
+        }
+    }
+
+    ARIEL_CONSTEXPR20 ~OptionalLock() {
+        unlock();
+    }
+};
+
+/**
+ * @brief Intrusive reference-counted pointer
+ *
+ * Unlike std::shared_ptr it is a literal type in C++20 builds, so objects
+ * holding one can still be used in constant expressions while null.
+ * P must provide retain() and release_ref(), the latter destroying the
+ * object when the last reference goes away.
+ *
+ * @tparam P The pointee type
+ */
+template <typename P>
+class IntrusivePtr {
+private:
+    P* ptr = nullptr;  ///< Referenced object, or null
+
+public:
+    constexpr IntrusivePtr() = default;
+
+    /**
+     * @brief Take a new reference to p
+     * @param p Object to reference (may be null)
+     */
+    constexpr explicit IntrusivePtr(P* p) : ptr(p) {
+        if (ptr) {
+            ptr->retain();
+        }
+    }
+
+    constexpr IntrusivePtr(const IntrusivePtr& other) : IntrusivePtr(other.ptr) {}
+
+    constexpr IntrusivePtr(IntrusivePtr&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+
+    constexpr IntrusivePtr& operator=(IntrusivePtr other) noexcept {
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+
+    ARIEL_CONSTEXPR20 ~IntrusivePtr() {
+        if (ptr) {
+            ptr->release_ref();
+        }
+    }
+
+    constexpr P* get() const { return ptr; }
+    constexpr P* operator->() const { return ptr; }
+    constexpr explicit operator bool() const { return ptr != nullptr; }
+};
+
+/**
+ * @brief Owning pointer that is a literal type in C++20 builds
+ *
+ * A minimal stand-in for std::unique_ptr, which is constexpr only from
+ * C++23, so objects holding one can still be used in constant expressions
+ * while it is null.
+ *
+ * @tparam P The pointee type
+ */
+template <typename P>
+class OwningPtr {
+private:
+    P* ptr = nullptr;  ///< Owned object, or null
+
+public:
+    constexpr OwningPtr() = default;
+
+    OwningPtr(const OwningPtr&) = delete;
+    OwningPtr& operator=(const OwningPtr&) = delete;
+
+    constexpr OwningPtr(OwningPtr&& other) noexcept : ptr(std::exchange(other.ptr, nullptr)) {}
+
+    ARIEL_CONSTEXPR20 OwningPtr& operator=(OwningPtr&& other) noexcept {
+        reset(std::exchange(other.ptr, nullptr));
+        return *this;
+    }
+
+    ARIEL_CONSTEXPR20 ~OwningPtr() {
+        reset();
+    }
+
+    /**
+     * @brief Take ownership of p, destroying the previously owned object
+     * @param p Object to own (may be null)
+     */
+    ARIEL_CONSTEXPR20 void reset(P* p = nullptr) {
+        delete std::exchange(ptr, p);
+    }
+
+    constexpr P* get() const { return ptr; }
+    constexpr P* operator->() const { return ptr; }
+    constexpr explicit operator bool() const { return ptr != nullptr; }
+};
+
+/**
+ * @brief Check whether an order is defined on the sorted elements
+ * @param order The iteration order
+ * @return true for Ascending, Descending and SideCross
+ */
+constexpr bool is_sorted_order(Order order) {
+    return order == Order::Ascending || order == Order::Descending || order == Order::SideCross;
+}
+
+/**
+ * @brief Map a position in an iteration order to its source index
+ *
+ * For sorted orders the returned index refers to the ascending-sorted
+ * elements, otherwise to the elements in insertion order.
+ *
+ * @param order The iteration order
+ * @param n Number of elements
+ * @param pos Position within the iteration (0 <= pos < n)
+ * @return Index of the element visited at position pos
+ */
+constexpr size_t source_index(Order order, size_t n, size_t pos) {
+    switch (order) {
+        case Order::Descending:
+        case Order::Reverse:
+            return n - 1 - pos;
+        case Order::SideCross:
+            return (pos % 2 == 0) ? pos / 2 : n - 1 - pos / 2;
+        case Order::MiddleOut: {
+            size_t k = (pos + 1) / 2;
+            return (pos % 2 == 1) ? n / 2 - k : n / 2 + k;
+        }
+        default:
+            return pos;
+    }
+}
+
+/**
+ * @brief Detects whether an ordering policy declares itself an identity mapping
+ */
+template <typename Policy, typename = void>
+struct is_identity_policy : std::false_type {};
+
+template <typename Policy>
+struct is_identity_policy<Policy, std::void_t<decltype(Policy::identity)>>
+    : std::bool_constant<Policy::identity> {};
+
+/**
+ * @brief Projection returning its argument unchanged (std::identity before C++20)
+ */
+struct identity {
+    template <typename U>
+    constexpr U&& operator()(U&& value) const noexcept {
+        return std::forward<U>(value);
+    }
+};
+
+/**
+ * @brief Orders two values by comparing their projections
+ * @tparam Comp Comparator applied to the projected values
+ * @tparam Proj Projection (callable or member pointer) applied to each value
+ */
+template <typename Comp, typename Proj>
+struct projected_less {
+    Comp comp;  ///< Comparator for projected values
+    Proj proj;  ///< Projection applied before comparing
+
+    template <typename A, typename B>
+    ARIEL_CONSTEXPR20 bool operator()(const A& a, const B& b) const {
+        return std::invoke(comp, std::invoke(proj, a), std::invoke(proj, b));
+    }
+};
+
+/**
+ * @brief Tag selecting the iterator constructors that sort with a per-call comparator
+ */
+struct sort_with_t {
+    explicit sort_with_t() = default;
+};
+inline constexpr sort_with_t sort_with{};
+
+/**
+ * @brief Tag selecting the end-iterator constructors, which never build an ordering
+ */
+struct end_tag_t {
+    explicit end_tag_t() = default;
+};
+inline constexpr end_tag_t end_tag{};
+
+/**
+ * @brief Result of operator-> for iterators whose reference is a proxy value
+ * @tparam Reference The proxy type returned by operator*
+ */
+template <typename Reference>
+struct ArrowProxy {
+    Reference value;  ///< The dereferenced proxy
+
+    constexpr const Reference* operator->() const { return &value; }
+};
+
+/**
+ * @brief Number of chunks a range of n elements is split into
+ * @param n Number of elements
+ * @param policy Execution policy
+ * @return Number of chunks (at least 1)
+ */
+ARIEL_CONSTEXPR20 inline size_t chunk_count(size_t n, const ExecutionPolicy& policy) {
+    size_t threads = policy.threads;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (policy.grain > 0) {
+        threads = std::min(threads, std::max<size_t>(1, n / policy.grain));
+    }
+    return std::max<size_t>(1, std::min(threads, n));
+}
+
+/**
+ * @brief Run f(chunk, begin, end) for chunks >= 2 on separate threads
+ * @see parallel_chunks
+ */
+template <typename F>
+void run_chunks_on_threads(size_t n, size_t chunks, F& f) {
+    std::vector<std::exception_ptr> errors(chunks);
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+    auto run = [&](size_t chunk) {
+        try {
+            f(chunk, chunk * n / chunks, (chunk + 1) * n / chunks);
+        } catch (...) {
+            errors[chunk] = std::current_exception();
+        }
+    };
+    for (size_t chunk = 0; chunk + 1 < chunks; ++chunk) {
+        workers.emplace_back(run, chunk);
+    }
+    run(chunks - 1);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+/**
+ * @brief Run f(chunk, begin, end) over contiguous chunks of [0, n)
+ *
+ * Chunk i covers [i * n / chunks, (i + 1) * n / chunks). The last chunk
+ * runs on the calling thread. The first exception thrown by any chunk is
+ * rethrown after all threads have been joined.
+ *
+ * @param n Number of elements
+ * @param chunks Number of chunks, as returned by chunk_count()
+ * @param f Callable invoked once per chunk
+ */
+template <typename F>
+ARIEL_CONSTEXPR20 void parallel_chunks(size_t n, size_t chunks, F&& f) {
+    if (chunks <= 1) {
+        f(size_t(0), size_t(0), n);
+        return;
+    }
+    run_chunks_on_threads(n, chunks, f);
+}
+
+/**
+ * @brief Run f(begin, end) over [0, n) split according to a policy
+ * @param n Number of elements
+ * @param policy Execution policy
+ * @param f Callable invoked once per chunk
+ */
+template <typename F>
+ARIEL_CONSTEXPR20 void parallel_for(size_t n, const ExecutionPolicy& policy, F&& f) {
+    parallel_chunks(n, chunk_count(n, policy),
+                    [&](size_t, size_t begin, size_t end) { f(begin, end); });
+}
+
+/**
+ * @brief Sort a random access range, sorting chunks in parallel and
+ *        merging neighbouring runs pairwise
+ * @param first Beginning of the range
+ * @param last End of the range
+ * @param comp Strict weak ordering
+ * @param policy Execution policy
+ */
+template <typename RandomIt, typename Compare>
+ARIEL_CONSTEXPR20 void parallel_sort(RandomIt first, RandomIt last, Compare comp, const ExecutionPolicy& policy) {
+    size_t n = static_cast<size_t>(last - first);
+    size_t chunks = chunk_count(n, policy);
+    if (chunks <= 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+    parallel_chunks(n, chunks, [&](size_t, size_t begin, size_t end) {
+        std::sort(first + begin, first + end, comp);
+    });
+    // Merge runs of `width` chunks pairwise until a single run remains
+    for (size_t width = 1; width < chunks; width *= 2) {
+        size_t pairs = (chunks + 2 * width - 1) / (2 * width);
+        parallel_chunks(pairs, pairs, [&](size_t pair, size_t, size_t) {
+            size_t lo = 2 * pair * width;
+            size_t mid = std::min(lo + width, chunks);
+            size_t hi = std::min(lo + 2 * width, chunks);
+            if (mid < hi) {
+                std::inplace_merge(first + lo * n / chunks, first + mid * n / chunks,
+                                   first + hi * n / chunks, comp);
+            }
+        });
+    }
+}
+
+/**
+ * @brief Detects element/comparator pairs ordered byte-wise lexicographically,
+ *        which can be sorted by packed prefix keys (see prefix_key_sort)
+ */
+template <typename T, typename Compare>
+struct has_prefix_key : std::false_type {};
+
+template <typename A>
+struct has_prefix_key<std::basic_string<char, std::char_traits<char>, A>,
+                      std::less<std::basic_string<char, std::char_traits<char>, A>>> : std::true_type {};
+
+template <typename A>
+struct has_prefix_key<std::basic_string<char, std::char_traits<char>, A>, std::less<>> : std::true_type {};
+
+/// Minimum number of elements for which sorting by prefix keys pays off
+inline constexpr size_t prefix_key_threshold = 64;
+
+/**
+ * @brief Pack the first 8 bytes of a string into an integer whose order
+ *        matches the lexicographic order of those bytes
+ * @param data The string's characters
+ * @param size The string's length (missing bytes count as 0)
+ * @return The big-endian prefix key
+ */
+inline uint64_t prefix_key(const char* data, size_t size) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        key <<= 8;
+        if (i < size) {
+            key |= static_cast<unsigned char>(data[i]);
+        }
+    }
+    return key;
+}
+
+/**
+ * @brief Sort indices of strings by (prefix key, index) pairs
+ *
+ * Most comparisons are resolved by the 16-byte pairs, which sort without
+ * touching the strings; equal keys fall back to a full comparison.
+ *
+ * @param values Random access iterator to the strings the indices refer to
+ * @param first Beginning of the range of indices
+ * @param last End of the range of indices
+ * @param alloc Allocator (of any value type) for the key buffer
+ * @param policy Execution policy
+ */
+template <typename ValueIt, typename IndexIt, typename Alloc>
+void prefix_key_sort_indices(ValueIt values, IndexIt first, IndexIt last, const Alloc& alloc,
+                             const ExecutionPolicy& policy) {
+    using entry = std::pair<uint64_t, size_t>;
+    using entry_alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<entry>;
+    using index_type = typename std::iterator_traits<IndexIt>::value_type;
+
+    size_t n = static_cast<size_t>(last - first);
+    std::vector<entry, entry_alloc> keys(n, entry(), entry_alloc(alloc));
+    parallel_for(n, policy, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            size_t value = static_cast<size_t>(first[i]);
+            keys[i] = entry(prefix_key(values[value].data(), values[value].size()), value);
+        }
+    });
+    parallel_sort(keys.begin(), keys.end(), [values](const entry& a, const entry& b) {
+        if (a.first != b.first) {
+            return a.first < b.first;
+        }
+        int order = values[a.second].compare(values[b.second]);
+        return order != 0 ? order < 0 : a.second < b.second;  // equal strings keep their order
+    }, policy);
+    for (size_t i = 0; i < n; ++i) {
+        first[i] = static_cast<index_type>(keys[i].second);
+    }
+}
+
+/**
+ * @brief Sort strings by (prefix key, index) pairs, then move each string
+ *        into place once (see prefix_key_sort_indices)
+ * @param first Beginning of the range of strings
+ * @param last End of the range
+ * @param alloc Allocator (of any value type) for the key and scratch buffers
+ * @param policy Execution policy
+ */
+template <typename RandomIt, typename Alloc>
+void prefix_key_sort(RandomIt first, RandomIt last, const Alloc& alloc, const ExecutionPolicy& policy) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    using traits = std::allocator_traits<Alloc>;
+    using index_alloc = typename traits::template rebind_alloc<size_t>;
+    using value_alloc = typename traits::template rebind_alloc<value_type>;
+
+    size_t n = static_cast<size_t>(last - first);
+    std::vector<size_t, index_alloc> indices(n, 0, index_alloc(alloc));
+    for (size_t i = 0; i < n; ++i) {
+        indices[i] = i;
+    }
+    prefix_key_sort_indices(first, indices.begin(), indices.end(), alloc, policy);
+
+    std::vector<value_type, value_alloc> sorted{value_alloc(alloc)};
+    sorted.reserve(n);
+    for (size_t index : indices) {
+        sorted.push_back(std::move(first[index]));
+    }
+    std::move(sorted.begin(), sorted.end(), first);
+}
+
+/**
+ * @brief Stable merge of two adjacent sorted ranges through a reusable buffer
+ *
+ * Elements of the left range already before the right one, and of the
+ * right range already after the left one, are left in place. The shorter
+ * of the remaining parts is copied to buffer, which therefore never grows
+ * beyond half of the range and can be reused across merges.
+ *
+ * @param first Beginning of the left range
+ * @param middle End of the left range and beginning of the right range
+ * @param last End of the right range
+ * @param less Strict weak ordering
+ * @param buffer Resizable container of the range's value type
+ */
+template <typename RandomIt, typename Less, typename Buffer>
+void merge_adjacent(RandomIt first, RandomIt middle, RandomIt last, Less less, Buffer& buffer) {
+    if (first == middle || middle == last) {
+        return;
+    }
+    first = std::upper_bound(first, middle, *middle, less);
+    last = std::lower_bound(middle, last, *(middle - 1), less);
+    if (first == middle || middle == last) {
+        return;
+    }
+    if (middle - first <= last - middle) {
+        buffer.assign(first, middle);
+        auto left = buffer.begin();
+        auto left_end = buffer.end();
+        RandomIt out = first;
+        while (left != left_end && middle != last) {
+            *out++ = less(*middle, *left) ? *middle++ : *left++;
+        }
+        std::copy(left, left_end, out);
+    } else {
+        buffer.assign(middle, last);
+        auto right_begin = buffer.begin();
+        auto right = buffer.end();
+        RandomIt out = last;
+        while (right != right_begin && middle != first) {
+            *--out = less(*(right - 1), *(middle - 1)) ? *--middle : *--right;
+        }
+        std::copy_backward(right_begin, right, out);
+    }
+}
+
+/**
+ * @brief Sort indices by merging the natural runs of the values they refer to
+ *
+ * Non-descending runs are kept and strictly descending runs reversed
+ * (which keeps equal elements in order), then neighbouring runs are merged
+ * pairwise with a stable merge. Sorted and reverse-sorted input takes one
+ * O(n) pass; input with r runs takes O(n log r). Run boundaries are found
+ * again on every merge pass rather than stored, so nothing is allocated
+ * beyond the caller's merge buffer (see merge_adjacent). Gives up, leaving
+ * the indices permuted but not sorted, as soon as more than max_runs runs
+ * are found.
+ *
+ * @param indices Random access iterator to n indices (the identity permutation)
+ * @param n Number of indices
+ * @param less Strict weak ordering on indices
+ * @param max_runs Maximum number of runs worth merging
+ * @param buffer Merge buffer, a resizable container of indices
+ * @return true if the indices were sorted
+ */
+template <typename IndexIt, typename Less, typename Buffer>
+bool natural_merge_sort(IndexIt indices, size_t n, Less less, size_t max_runs, Buffer& buffer) {
+    size_t runs = 0;
+    for (size_t begin = 0; begin < n; ++runs) {
+        if (runs == max_runs) {
+            return false;
+        }
+        size_t end = begin + 1;
+        if (end < n && less(indices[end], indices[begin])) {
+            while (end < n && less(indices[end], indices[end - 1])) {
+                ++end;
+            }
+            std::reverse(indices + begin, indices + end);
+        } else {
+            while (end < n && !less(indices[end], indices[end - 1])) {
+                ++end;
+            }
+        }
+        begin = end;
+    }
+    auto run_end = [&](size_t begin) {
+        size_t end = begin + 1;
+        while (end < n && !less(indices[end], indices[end - 1])) {
+            ++end;
+        }
+        return end;
+    };
+    while (runs > 1) {
+        runs = 0;
+        for (size_t begin = 0; begin < n; ++runs) {
+            size_t middle = run_end(begin);
+            if (middle == n) {
+                begin = n;
+            } else {
+                size_t end = run_end(middle);
+                merge_adjacent(indices + begin, indices + middle, indices + end, less, buffer);
+                begin = end;
+            }
+        }
+    }
+    return true;
+}
+
+/// Runs of at least this average length are merged instead of sorting from scratch
+inline constexpr size_t natural_run_length = 32;
+
+/// Minimum number of elements for which binary searches avoid branching
+inline constexpr size_t branchless_search_threshold = 64;
+
+/**
+ * @brief Find the first position of a partitioned sequence for which a
+ *        predicate is false
+ *
+ * Large sequences are searched without a data-dependent branch: the range
+ * is halved a fixed number of times (log2 n + 1 probes) and the compiler
+ * can select the next base with a conditional move, so mispredictions do
+ * not stall the search.
+ *
+ * @param n Length of the sequence
+ * @param before Predicate on positions, true for a prefix of [0, n)
+ * @return The number of positions for which before is true
+ */
+template <typename Before>
+ARIEL_CONSTEXPR20 size_t partition_point(size_t n, Before before) {
+    if (n < branchless_search_threshold) {
+        size_t low = 0;
+        while (n > 0) {
+            size_t half = n / 2;
+            if (before(low + half)) {
+                low += half + 1;
+                n -= half + 1;
+            } else {
+                n = half;
+            }
+        }
+        return low;
+    }
+    size_t base = 0;
+    while (n > 1) {
+        size_t half = n / 2;
+        base = before(base + half) ? base + half : base;
+        n -= half;
+    }
+    return base + (before(base) ? 1 : 0);
+}
+
+/**
+ * @brief Detects whether Compare can order two elements of T; std::less<T>
+ *        is checked through the constrained std::less<> instead
+ */
+template <typename T, typename Compare>
+struct is_comparable : std::is_invocable_r<bool, const Compare&, const T&, const T&> {};
+
+template <typename T>
+struct is_comparable<T, std::less<T>> : is_comparable<T, std::less<>> {};
+
+/**
+ * @brief Detects integral element types under an ascending comparator,
+ *        which can be sorted by counting (see counting_range)
+ */
+template <typename T, typename Compare>
+struct has_counting_key : std::false_type {};
+
+template <typename T>
+struct has_counting_key<T, std::less<T>>
+    : std::bool_constant<std::is_integral<T>::value && !std::is_same<T, bool>::value> {};
+
+template <typename T>
+struct has_counting_key<T, std::less<>>
+    : std::bool_constant<std::is_integral<T>::value && !std::is_same<T, bool>::value> {};
+
+/// Minimum number of elements for which counting sort is considered
+inline constexpr size_t counting_sort_threshold = 256;
+
+/**
+ * @brief Find the value range of integers if it is small enough for a counting sort
+ *
+ * A strided sample is checked first, so wide ranges are rejected without
+ * a full pass over the values.
+ *
+ * @param first Random access iterator to the values
+ * @param n Number of values
+ * @return The smallest value and the number of histogram slots (at most n),
+ *         or nullopt if the range is wider than the number of values
+ */
+template <typename RandomIt>
+std::optional<std::pair<typename std::iterator_traits<RandomIt>::value_type, size_t>>
+counting_range(RandomIt first, size_t n) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    using unsigned_type = std::make_unsigned_t<value_type>;
+    auto span = [](value_type lo, value_type hi) {
+        return static_cast<uint64_t>(static_cast<unsigned_type>(static_cast<unsigned_type>(hi) -
+                                                                static_cast<unsigned_type>(lo)));
+    };
+
+    size_t stride = std::max<size_t>(1, n / 64);
+    value_type lo = first[0];
+    value_type hi = first[0];
+    for (size_t i = stride; i < n; i += stride) {
+        lo = std::min(lo, first[i]);
+        hi = std::max(hi, first[i]);
+    }
+    if (span(lo, hi) >= n) {
+        return std::nullopt;
+    }
+    auto bounds = std::minmax_element(first, first + n);
+    if (span(*bounds.first, *bounds.second) >= n) {
+        return std::nullopt;
+    }
+    return std::make_pair(*bounds.first, static_cast<size_t>(span(*bounds.first, *bounds.second)) + 1);
+}
+
+/**
+ * @brief Histogram of integers over [lo, lo + slots), as exclusive prefix sums
+ * @param first Random access iterator to the values
+ * @param n Number of values
+ * @param lo Smallest value
+ * @param slots Number of histogram slots
+ * @param alloc Allocator (of any value type) for the histogram
+ * @return offsets[k]: number of values below lo + k (slots + 1 entries)
+ */
+template <typename RandomIt, typename Alloc>
+auto counting_offsets(RandomIt first, size_t n, typename std::iterator_traits<RandomIt>::value_type lo,
+                      size_t slots, const Alloc& alloc) {
+    using unsigned_type = std::make_unsigned_t<typename std::iterator_traits<RandomIt>::value_type>;
+    using offset_alloc = typename std::allocator_traits<Alloc>::template rebind_alloc<size_t>;
+    std::vector<size_t, offset_alloc> offsets(slots + 1, 0, offset_alloc(alloc));
+    for (size_t i = 0; i < n; ++i) {
+        ++offsets[static_cast<unsigned_type>(static_cast<unsigned_type>(first[i]) -
+                                             static_cast<unsigned_type>(lo)) + 1];
+    }
+    for (size_t k = 0; k < slots; ++k) {
+        offsets[k + 1] += offsets[k];
+    }
+    return offsets;
+}
+
+/**
+ * @brief Write the indices of integers in ascending order by counting (stable)
+ * @param values Random access iterator to the values
+ * @param indices Random access iterator to n index slots receiving the permutation
+ * @param n Number of values
+ * @param range Smallest value and number of slots, from counting_range
+ * @param alloc Allocator (of any value type) for the histogram
+ */
+template <typename ValueIt, typename IndexIt, typename Range, typename Alloc>
+void counting_sort_indices(ValueIt values, IndexIt indices, size_t n, const Range& range, const Alloc& alloc) {
+    using unsigned_type = std::make_unsigned_t<typename std::iterator_traits<ValueIt>::value_type>;
+    using index_type = typename std::iterator_traits<IndexIt>::value_type;
+    auto offsets = counting_offsets(values, n, range.first, range.second, alloc);
+    for (size_t i = 0; i < n; ++i) {
+        size_t slot = static_cast<unsigned_type>(static_cast<unsigned_type>(values[i]) -
+                                                 static_cast<unsigned_type>(range.first));
+        indices[offsets[slot]++] = static_cast<index_type>(i);
+    }
+}
+
+/**
+ * @brief Sort integers in place by counting
+ * @param first Random access iterator to the values
+ * @param n Number of values
+ * @param range Smallest value and number of slots, from counting_range
+ * @param alloc Allocator (of any value type) for the histogram
+ */
+template <typename RandomIt, typename Range, typename Alloc>
+void counting_sort(RandomIt first, size_t n, const Range& range, const Alloc& alloc) {
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+    using unsigned_type = std::make_unsigned_t<value_type>;
+    auto offsets = counting_offsets(first, n, range.first, range.second, alloc);
+    for (size_t k = 0; k < range.second; ++k) {
+        value_type value = static_cast<value_type>(static_cast<unsigned_type>(
+            static_cast<unsigned_type>(range.first) + static_cast<unsigned_type>(k)));
+        std::fill(first + offsets[k], first + offsets[k + 1], value);
+    }
+}
+
+/**
+ * @brief Vector with inline capacity for N elements
+ *
+ * Up to N elements live inside the object itself; growing beyond that
+ * moves them to a heap buffer obtained from the allocator, exactly like
+ * std::vector. Provides the subset of the std::vector interface used by
+ * MyContainer. Iterators are plain pointers.
+ *
+ * @tparam T The element type
+ * @tparam N Inline capacity (at least 1)
+ * @tparam Allocator Allocator for the heap buffer
+ */
+template <typename T, size_t N, typename Allocator = std::allocator<T>>
+class SmallVector {
+    static_assert(N > 0, "SmallVector needs an inline capacity of at least one element");
+
+public:
+    using value_type = T;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using iterator = T*;
+    using const_iterator = const T*;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+private:
+    using traits = std::allocator_traits<Allocator>;
+
+    alignas(T) unsigned char inline_storage[N * sizeof(T)];  ///< In-object element storage
+    T* first;        ///< Current buffer (inline_storage or heap)
+    size_t count;    ///< Number of constructed elements
+    size_t cap;      ///< Capacity of the current buffer
+    Allocator alloc; ///< Allocator for heap buffers
+
+    T* inline_data() { return reinterpret_cast<T*>(inline_storage); }
+
+    /**
+     * @brief Destroy the elements and free the heap buffer, if any
+     */
+    void release() {
+        clear();
+        if (!is_inline()) {
+            traits::deallocate(alloc, first, cap);
+            first = inline_data();
+            cap = N;
+        }
+    }
+
+    /**
+     * @brief Take over the contents of other (this must be empty and inline)
+     * @param other Vector left empty and inline
+     */
+    void take_from(SmallVector& other) {
+        if (other.is_inline()) {
+            for (size_t i = 0; i < other.count; ++i) {
+                ::new (static_cast<void*>(first + i)) T(std::move(other.first[i]));
+            }
+            count = other.count;
+            other.clear();
+        } else {
+            first = other.first;
+            count = other.count;
+            cap = other.cap;
+            other.first = other.inline_data();
+            other.count = 0;
+            other.cap = N;
+        }
+    }
+
+    /**
+     * @brief Move the elements into a new buffer of the given capacity
+     * @param new_cap New capacity (greater than the current one)
+     * @param extra Callable constructing one extra element at a given address
+     *        before the old elements are moved, or nullptr
+     */
+    template <typename Extra>
+    void reallocate(size_t new_cap, Extra&& extra) {
+        constexpr bool has_extra = !std::is_same<std::decay_t<Extra>, std::nullptr_t>::value;
+        T* buffer = traits::allocate(alloc, new_cap);
+        bool extra_built = false;
+        size_t moved = 0;
+        try {
+            if constexpr (has_extra) {
+                extra(buffer + count);
+                extra_built = true;
+            }
+            for (; moved < count; ++moved) {
+                ::new (static_cast<void*>(buffer + moved)) T(std::move_if_noexcept(first[moved]));
+            }
+        } catch (...) {
+            for (size_t i = 0; i < moved; ++i) {
+                buffer[i].~T();
+            }
+            if (extra_built) {
+                buffer[count].~T();
+            }
+            traits::deallocate(alloc, buffer, new_cap);
+            throw;
+        }
+        size_t kept = count;
+        release();
+        first = buffer;
+        cap = new_cap;
+        count = kept;
+    }
+
+public:
+    SmallVector() : first(inline_data()), count(0), cap(N), alloc() {}
+
+    explicit SmallVector(const Allocator& a) : first(inline_data()), count(0), cap(N), alloc(a) {}
+
+    /**
+     * @brief Create n value-initialized elements
+     */
+    explicit SmallVector(size_t n, const Allocator& a = Allocator()) : SmallVector(a) {
+        resize(n);
+    }
+
+    SmallVector(const SmallVector& other)
+        : SmallVector(traits::select_on_container_copy_construction(other.alloc)) {
+        assign(other.begin(), other.end());
+    }
+
+    SmallVector(const SmallVector& other, const Allocator& a) : SmallVector(a) {
+        assign(other.begin(), other.end());
+    }
+
+    SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value)
+        : first(inline_data()), count(0), cap(N), alloc(std::move(other.alloc)) {
+        take_from(other);
+    }
+
+    SmallVector(SmallVector&& other, const Allocator& a) : SmallVector(a) {
+        if (alloc == other.alloc) {
+            take_from(other);
+        } else {
+            assign(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+            other.clear();
+        }
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            assign(other.begin(), other.end());
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept(
+        (traits::propagate_on_container_move_assignment::value || traits::is_always_equal::value) &&
+        std::is_nothrow_move_constructible<T>::value) {
+        if (this == &other) {
+            return *this;
+        }
+        if (traits::propagate_on_container_move_assignment::value || alloc == other.alloc) {
+            release();
+            if constexpr (traits::propagate_on_container_move_assignment::value) {
+                alloc = std::move(other.alloc);
+            }
+            take_from(other);
+        } else {
+            assign(std::make_move_iterator(other.begin()), std::make_move_iterator(other.end()));
+            other.clear();
+        }
+        return *this;
+    }
+
+    ~SmallVector() { release(); }
+
+    ARIEL_CONSTEXPR20 allocator_type get_allocator() const { return alloc; }
+
+    /**
+     * @brief Check whether the elements are stored in-object
+     * @return true while no heap buffer is in use
+     */
+    bool is_inline() const { return first == reinterpret_cast<const T*>(inline_storage); }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return cap; }
+    bool empty() const { return count == 0; }
+    size_t max_size() const { return traits::max_size(alloc); }
+
+    T* data() { return first; }
+    const T* data() const { return first; }
+    T& operator[](size_t i) { return first[i]; }
+    const T& operator[](size_t i) const { return first[i]; }
+    T& front() { return first[0]; }
+    const T& front() const { return first[0]; }
+    T& back() { return first[count - 1]; }
+    const T& back() const { return first[count - 1]; }
+
+    iterator begin() { return first; }
+    iterator end() { return first + count; }
+    const_iterator begin() const { return first; }
+    const_iterator end() const { return first + count; }
+    const_iterator cbegin() const { return first; }
+    const_iterator cend() const { return first + count; }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+    void reserve(size_t n) {
+        if (n > cap) {
+            reallocate(n, nullptr);
+        }
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
+        if (count == cap) {
+            // Construct the new element first: args may refer to an existing element
+            reallocate(std::max<size_t>(2 * cap, 1), [&](T* slot) {
+                ::new (static_cast<void*>(slot)) T(std::forward<Args>(args)...);
+            });
+        } else {
+            ::new (static_cast<void*>(first + count)) T(std::forward<Args>(args)...);
+        }
+        return first[count++];
+    }
+
+    void push_back(const T& value) { emplace_back(value); }
+    void push_back(T&& value) { emplace_back(std::move(value)); }
+
+    void pop_back() { first[--count].~T(); }
+
+    void clear() {
+        for (size_t i = 0; i < count; ++i) {
+            first[i].~T();
+        }
+        count = 0;
+    }
+
+    iterator erase(const_iterator from, const_iterator to) {
+        T* target = first + (from - first);
+        if (from != to) {
+            T* new_end = std::move(first + (to - first), end(), target);
+            while (end() != new_end) {
+                pop_back();
+            }
+        }
+        return target;
+    }
+
+    iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+    void resize(size_t n) {
+        while (count > n) {
+            pop_back();
+        }
+        reserve(n);
+        while (count < n) {
+            emplace_back();
+        }
+    }
+
+    void resize(size_t n, const T& value) {
+        while (count > n) {
+            pop_back();
+        }
+        reserve(n);
+        while (count < n) {
+            emplace_back(value);
+        }
+    }
+
+    template <typename InputIt>
+    void assign(InputIt from, InputIt to) {
+        clear();
+        using category = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value) {
+            reserve(static_cast<size_t>(std::distance(from, to)));
+        }
+        for (; from != to; ++from) {
+            emplace_back(*from);
+        }
+    }
+
+    void swap(SmallVector& other) {
+        if (this == &other) {
+            return;
+        }
+        if (!is_inline() && !other.is_inline() && alloc == other.alloc) {
+            std::swap(first, other.first);
+            std::swap(count, other.count);
+            std::swap(cap, other.cap);
+            return;
+        }
+        SmallVector temp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temp);
+    }
+};
+
+/**
+ * @brief Check whether a buffer holds heap memory worth recycling
+ */
+template <typename T, typename A>
+bool owns_heap_buffer(const std::vector<T, A>& buffer) {
+    return buffer.capacity() > 0;
+}
+
+template <typename T, size_t N, typename A>
+bool owns_heap_buffer(const SmallVector<T, N, A>& buffer) {
+    return !buffer.is_inline();
+}
+
+/**
+ * @brief A permutation of element indices
+ *
+ * Indices are stored as uint32_t, so an ordering costs 4 bytes per element
+ * whatever the element type; permutations of more than 2^32 elements
+ * switch to uint64_t. Only the uint32_t buffer has inline capacity, since
+ * the uint64_t one is never used at sizes that would fit inline.
+ *
+ * @tparam Allocator Allocator (of any value type) for the index buffers
+ * @tparam InlineN Inline capacity of the uint32_t buffer (0: std::vector)
+ */
+template <typename Allocator, size_t InlineN>
+class Permutation {
+public:
+    /// Buffer holding 32-bit indices
+    using narrow_type = std::conditional_t<
+        InlineN == 0,
+        std::vector<uint32_t, typename std::allocator_traits<Allocator>::template rebind_alloc<uint32_t>>,
+        SmallVector<uint32_t, InlineN, typename std::allocator_traits<Allocator>::template rebind_alloc<uint32_t>>>;
+    /// Buffer holding 64-bit indices
+    using wide_type = std::vector<uint64_t, typename std::allocator_traits<Allocator>::template rebind_alloc<uint64_t>>;
+
+private:
+    narrow_type narrow;  ///< Indices while they fit in 32 bits
+    wide_type wide;      ///< Indices of permutations of more than 2^32 elements
+    bool is_wide = false;          ///< Which buffer is in use
+
+public:
+    /**
+     * @brief Create an empty permutation
+     * @param alloc Allocator for the index buffers
+     */
+    ARIEL_CONSTEXPR20 explicit Permutation(const Allocator& alloc)
+        : narrow(typename narrow_type::allocator_type(alloc)),
+          wide(typename wide_type::allocator_type(alloc)) {}
+
+    ARIEL_CONSTEXPR20 Allocator get_allocator() const { return Allocator(narrow.get_allocator()); }
+    ARIEL_CONSTEXPR20 size_t size() const { return is_wide ? wide.size() : narrow.size(); }
+    ARIEL_CONSTEXPR20 bool empty() const { return size() == 0; }
+
+    /**
+     * @brief Get the index at a position
+     * @param pos Position within the permutation
+     * @return The element index stored there
+     */
+    ARIEL_CONSTEXPR20 size_t operator[](size_t pos) const {
+        return is_wide ? static_cast<size_t>(wide[pos]) : narrow[pos];
+    }
+
+    /**
+     * @brief Check whether every position holds its own index
+     */
+    ARIEL_CONSTEXPR20 bool is_identity() const {
+        return visit([](const auto& indices) {
+            for (size_t pos = 0; pos < indices.size(); ++pos) {
+                if (indices[pos] != pos) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    /**
+     * @brief Remove all indices, keeping the buffers' capacity
+     */
+    ARIEL_CONSTEXPR20 void clear() {
+        narrow.clear();
+        wide.clear();
+    }
+
+    /**
+     * @brief Make this the identity permutation of n elements
+     * @param n Number of elements
+     */
+    ARIEL_CONSTEXPR20 void assign_identity(size_t n) {
+        clear();
+        is_wide = n > std::numeric_limits<uint32_t>::max();
+        visit([n](auto& indices) {
+            using index_type = typename std::decay_t<decltype(indices)>::value_type;
+            indices.reserve(n);
+            for (size_t i = 0; i < n; ++i) {
+                indices.push_back(static_cast<index_type>(i));
+            }
+        });
+    }
+
+    /**
+     * @brief Append the indices size() .. n-1, widening the indices if needed
+     * @param n Number of elements after the append
+     */
+    ARIEL_CONSTEXPR20 void extend(size_t n) {
+        size_t first = size();
+        if (!is_wide && n > std::numeric_limits<uint32_t>::max()) {
+            wide.assign(narrow.begin(), narrow.end());
+            narrow.clear();
+            is_wide = true;
+        }
+        visit([&](auto& indices) {
+            using index_type = typename std::decay_t<decltype(indices)>::value_type;
+            for (size_t i = first; i < n; ++i) {
+                indices.push_back(static_cast<index_type>(i));
+            }
+        });
+    }
+
+    /**
+     * @brief Drop the indices of removed elements and renumber the others
+     *        to their positions once the removed elements are compacted away
+     * @param removed Flags indexed by element, nonzero for removed elements
+     *                (covering at least every index in the permutation)
+     */
+    template <typename Flags>
+    ARIEL_CONSTEXPR20 void drop_removed(const Flags& removed) {
+        visit([&](auto& indices) {
+            using buffer = std::decay_t<decltype(indices)>;
+            buffer renumbered(removed.size(), indices.get_allocator());
+            size_t dropped = 0;
+            for (size_t i = 0; i < removed.size(); ++i) {
+                renumbered[i] = static_cast<typename buffer::value_type>(i - dropped);
+                dropped += removed[i] != 0;
+            }
+            indices.erase(std::remove_if(indices.begin(), indices.end(),
+                                         [&](size_t index) { return removed[index] != 0; }),
+                          indices.end());
+            for (auto& index : indices) {
+                index = renumbered[index];
+            }
+        });
+    }
+
+    /**
+     * @brief Drop one index and renumber the larger ones, as when the
+     *        element it refers to is erased
+     * @param removed The index to drop
+     */
+    ARIEL_CONSTEXPR20 void erase_index(size_t removed) {
+        visit([&](auto& indices) {
+            size_t kept = 0;
+            for (size_t pos = 0; pos < indices.size(); ++pos) {
+                size_t index = indices[pos];
+                if (index != removed) {
+                    indices[kept++] = static_cast<typename std::decay_t<decltype(indices)>::value_type>(
+                        index > removed ? index - 1 : index);
+                }
+            }
+            indices.erase(indices.begin() + static_cast<std::ptrdiff_t>(kept), indices.end());
+        });
+    }
+
+    /**
+     * @brief Make this the composition of another permutation with a position mapping
+     * @param source The permutation to read from
+     * @param map Callable mapping (n, pos) to a position in source
+     */
+    template <typename Map>
+    ARIEL_CONSTEXPR20 void assign_mapped(const Permutation& source, Map map) {
+        size_t n = source.size();
+        clear();
+        is_wide = source.is_wide;
+        visit([&](auto& indices) {
+            using index_type = typename std::decay_t<decltype(indices)>::value_type;
+            indices.reserve(n);
+            for (size_t pos = 0; pos < n; ++pos) {
+                indices.push_back(static_cast<index_type>(source[map(n, pos)]));
+            }
+        });
+    }
+
+    /**
+     * @brief Call f with the index buffer in use (e.g. to sort it)
+     * @param f Callable taking a reference to narrow_type or wide_type
+     */
+    template <typename F>
+    ARIEL_CONSTEXPR20 void visit(F&& f) {
+        if (is_wide) {
+            f(wide);
+        } else {
+            f(narrow);
+        }
+    }
+
+    template <typename F>
+    ARIEL_CONSTEXPR20 decltype(auto) visit(F&& f) const {
+        if (is_wide) {
+            return f(wide);
+        }
+        return f(narrow);
+    }
+
+    ARIEL_CONSTEXPR20 void swap(Permutation& other) {
+        narrow.swap(other.narrow);
+        wide.swap(other.wide);
+        std::swap(is_wide, other.is_wide);
+    }
+
+    /**
+     * @brief Check whether either index buffer holds heap memory
+     */
+    bool owns_heap_memory() const {
+        return owns_heap_buffer(narrow) || owns_heap_buffer(wide);
+    }
+};
+
+template <typename A, size_t N>
+bool owns_heap_buffer(const Permutation<A, N>& buffer) {
+    return buffer.owns_heap_memory();
+}
+
+/**
+ * @brief Detects element types usable as keys of a CountIndex
+ */
+template <typename T, typename = void>
+struct is_hashable : std::false_type {};
+
+template <typename T>
+struct is_hashable<T, std::void_t<decltype(std::hash<T>()(std::declval<const T&>())),
+                                  decltype(std::declval<const T&>() == std::declval<const T&>())>>
+    : std::bool_constant<std::is_default_constructible<std::hash<T>>::value &&
+                         std::is_default_constructible<T>::value> {};
+
+/**
+ * @brief Detects comparators whose equivalence is operator== for sane types
+ */
+template <typename T, typename Compare>
+struct is_default_less
+    : std::bool_constant<std::is_same<Compare, std::less<T>>::value || std::is_same<Compare, std::less<>>::value> {};
+
+/**
+ * @brief Flat open-addressing hash table counting occurrences of values
+ *
+ * Slots live in one array probed linearly from a Fibonacci-hashed home slot
+ * (so identity hashes of patterned integers still spread out), with a load
+ * factor of at most 3/4. Erasing shifts the rest of the probe run back
+ * instead of leaving tombstones, so lookups of absent values stop at the
+ * first empty slot.
+ *
+ * @tparam T The type of values (see is_hashable)
+ * @tparam Allocator Allocator (of any value type) for the slots
+ */
+template <typename T, typename Allocator>
+class CountIndex {
+private:
+    struct Slot {
+        T value{};         ///< Value stored in the slot
+        size_t count = 0;  ///< Occurrences of value, 0 if the slot is empty
+    };
+    using slot_alloc = typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+
+    std::vector<Slot, slot_alloc> slots;  ///< Power-of-two number of slots (none until the first add)
+    size_t used = 0;                      ///< Number of non-empty slots
+    unsigned shift = 0;                   ///< 64 - log2(slots.size())
+
+    size_t home(const T& value) const {
+        return static_cast<size_t>((static_cast<uint64_t>(std::hash<T>()(value)) * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    /**
+     * @brief Find the slot of a value, or the empty slot where it would go
+     */
+    size_t find(const T& value) const {
+        size_t mask = slots.size() - 1;
+        size_t slot = home(value);
+        while (slots[slot].count != 0 && !(slots[slot].value == value)) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<Slot, slot_alloc> old(capacity, slots.get_allocator());
+        old.swap(slots);
+        shift = 64;
+        for (size_t c = capacity; c > 1; c /= 2) {
+            --shift;
+        }
+        for (Slot& slot : old) {
+            if (slot.count != 0) {
+                slots[find(slot.value)] = std::move(slot);
+            }
+        }
+    }
+
+public:
+    ARIEL_CONSTEXPR20 explicit CountIndex(const Allocator& alloc) : slots(slot_alloc(alloc)) {}
+
+    /**
+     * @brief Remove all values and release the slots
+     */
+    ARIEL_CONSTEXPR20 void clear() {
+        std::vector<Slot, slot_alloc>(slots.get_allocator()).swap(slots);
+        used = 0;
+    }
+
+    /**
+     * @brief Count one more occurrence of a value
+     * @param value The value
+     */
+    void add(const T& value) {
+        if ((used + 1) * 4 > slots.size() * 3) {
+            rehash(std::max<size_t>(16, 2 * slots.size()));
+        }
+        Slot& slot = slots[find(value)];
+        if (slot.count == 0) {
+            slot.value = value;
+            ++used;
+        }
+        ++slot.count;
+    }
+
+    /**
+     * @brief Get the number of occurrences of a value
+     * @param value The value
+     * @return The count, 0 if absent
+     */
+    size_t count(const T& value) const {
+        return slots.empty() ? 0 : slots[find(value)].count;
+    }
+
+    /**
+     * @brief Count one occurrence of a value less
+     * @param value The value (which must be present)
+     */
+    void subtract(const T& value) {
+        Slot& slot = slots[find(value)];
+        if (slot.count == 1) {
+            erase(value);
+        } else {
+            --slot.count;
+        }
+    }
+
+    /**
+     * @brief Forget every occurrence of a value
+     * @param value The value
+     */
+    void erase(const T& value) {
+        if (slots.empty()) {
+            return;
+        }
+        size_t mask = slots.size() - 1;
+        size_t hole = find(value);
+        if (slots[hole].count == 0) {
+            return;
+        }
+        slots[hole].count = 0;
+        --used;
+        for (size_t next = (hole + 1) & mask; slots[next].count != 0; next = (next + 1) & mask) {
+            // The entry can fill the hole unless its home lies cyclically in (hole, next]
+            if (((next - home(slots[next].value)) & mask) >= ((next - hole) & mask)) {
+                slots[hole] = std::move(slots[next]);
+                slots[next].count = 0;
+                hole = next;
+            }
+        }
+    }
+};
+
+/**
+ * @brief Copy of a sorted sequence in Eytzinger (breadth-first) order
+ *
+ * Node k (1-based) has children 2k and 2k + 1, so a search reads one
+ * element per tree level, the first levels share a few hot cache lines, and
+ * the descendants four levels down of small elements sit in a single cache
+ * line, which is prefetched while the current level is compared. Each node
+ * also records its position in the sorted sequence.
+ *
+ * @tparam T The type of values
+ * @tparam Allocator Allocator for the values
+ */
+template <typename T, typename Allocator>
+class EytzingerIndex {
+private:
+    using rank_alloc = typename std::allocator_traits<Allocator>::template rebind_alloc<size_t>;
+
+    std::vector<T, Allocator> values;         ///< values[k - 1] is node k
+    std::vector<size_t, rank_alloc> ranks;    ///< ranks[k - 1] is node k's position in sorted order
+    size_t built_for = std::numeric_limits<size_t>::max();  ///< Version of the data the copy was built from
+
+public:
+    ARIEL_CONSTEXPR20 explicit EytzingerIndex(const Allocator& alloc) : values(alloc), ranks(rank_alloc(alloc)) {}
+
+    /**
+     * @brief Check whether the copy was built from a given version of the data
+     * @param version The version (e.g. a mutation counter)
+     */
+    ARIEL_CONSTEXPR20 bool current(size_t version) const {
+        return built_for == version;
+    }
+
+    /**
+     * @brief Rebuild the copy
+     * @param n Number of values
+     * @param sorted Callable returning the value at a sorted position
+     * @param version Version of the data, for current()
+     */
+    template <typename Sorted>
+    void build(size_t n, Sorted sorted, size_t version) {
+        ranks.assign(n, 0);
+        // Visit the nodes in order (leftmost node first) and number them
+        size_t node = 1;
+        while (2 * node <= n) {
+            node *= 2;
+        }
+        for (size_t rank = 0; rank < n; ++rank) {
+            ranks[node - 1] = rank;
+            if (2 * node + 1 <= n) {
+                node = 2 * node + 1;
+                while (2 * node <= n) {
+                    node *= 2;
+                }
+            } else {
+                while (node & 1) {
+                    node >>= 1;
+                }
+                node >>= 1;
+            }
+        }
+        values.clear();
+        values.reserve(n);
+        for (size_t rank : ranks) {
+            values.push_back(sorted(rank));
+        }
+        built_for = version;
+    }
+
+    /**
+     * @brief Release the copy
+     */
+    ARIEL_CONSTEXPR20 void clear() {
+        std::vector<T, Allocator>(values.get_allocator()).swap(values);
+        std::vector<size_t, rank_alloc>(ranks.get_allocator()).swap(ranks);
+        built_for = std::numeric_limits<size_t>::max();
+    }
+
+    /**
+     * @brief Find the first sorted position for which a predicate is false
+     * @param before Predicate on values, true for a prefix of the sorted sequence
+     * @return The number of values for which before is true
+     */
+    template <typename Before>
+    size_t partition_point(Before before) const {
+        constexpr size_t per_line = std::max<size_t>(1, 64 / sizeof(T));
+        size_t n = values.size();
+        const T* base = values.data();
+        size_t node = 1;
+        while (node <= n) {
+            ARIEL_PREFETCH(base + std::min(node * per_line, n) - 1);
+            node = 2 * node + (before(base[node - 1]) ? 1 : 0);
+        }
+        // Undo the right turns taken after the last left turn; that node is the answer
+        while (node & 1) {
+            node >>= 1;
+        }
+        node >>= 1;
+        return node == 0 ? n : ranks[node - 1];
+    }
+};
+
+} // namespace detail
+
+/**
+ * @brief Compile-time ordering policy for one of the built-in orders
+ *
+ * An ordering policy tells the container's iterators which element to visit
+ * at each position. User-defined orders are written the same way: a type
+ * with a `static constexpr bool sorted` member (true if `index` refers to the
+ * ascending-sorted elements rather than insertion order) and a
+ * `static constexpr size_t index(size_t n, size_t pos)` mapping. A policy may
+ * also set `static constexpr bool identity = true` when `index` returns pos,
+ * so the ordering is copied in bulk.
+ *
+ * @tparam O The iteration order
+ */
+template <Order O>
+struct OrderPolicy {
+    static constexpr bool sorted = detail::is_sorted_order(O);
+    static constexpr bool identity = (O == Order::Normal || O == Order::Ascending);
+
+    /**
+     * @brief Map a position in the order to its source index
+     * @param n Number of elements
+     * @param pos Position within the iteration
+     * @return Index of the element visited at position pos
+     */
+    static constexpr size_t index(size_t n, size_t pos) {
+        return detail::source_index(O, n, pos);
+    }
+};
+
+#ifdef ARIEL_HAS_COROUTINES
+/**
+ * @brief Minimal lazy coroutine generator (C++20 only)
+ *
+ * The coroutine runs until its next co_yield each time the iterator is
+ * advanced; yielded values are exposed by const reference.
+ *
+ * @tparam T The type of yielded values
+ */
+template <typename T>
+class Generator {
+public:
+    struct promise_type {
+        const T* current = nullptr;         ///< Value passed to the last co_yield
+        std::exception_ptr error;           ///< Exception escaping the coroutine
+
+        Generator get_return_object() {
+            return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(const T& value) noexcept {
+            current = std::addressof(value);
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    /**
+     * @brief Input iterator over the yielded values
+     */
+    class iterator {
+        handle_type handle;  ///< Coroutine being iterated (null at end)
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        explicit iterator(handle_type h = nullptr) : handle(h) { advance(); }
+
+        const T& operator*() const { return *handle.promise().current; }
+        const T* operator->() const { return handle.promise().current; }
+
+        iterator& operator++() {
+            advance();
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return handle == other.handle; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+
+    private:
+        void advance() {
+            if (!handle) {
+                return;
+            }
+            handle.resume();
+            if (handle.done()) {
+                std::exception_ptr error = handle.promise().error;
+                handle = nullptr;
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+        }
+    };
+
+    explicit Generator(handle_type h) : handle(h) {}
+    Generator(Generator&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+    Generator& operator=(Generator&& other) noexcept {
+        if (this != &other) {
+            if (handle) {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+    ~Generator() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    /**
+     * @brief Start (or resume) the coroutine and get an iterator to its next value
+     * @return Iterator to the next yielded value
+     */
+    iterator begin() { return iterator(handle); }
+
+    /**
+     * @brief Get the end sentinel
+     * @return Iterator compared against to detect completion
+     */
+    iterator end() { return iterator(); }
+
+private:
+    handle_type handle;  ///< Owned coroutine frame
+};
+#endif // ARIEL_HAS_COROUTINES
+
+/**
+ * @brief A pair of iterators usable in range-based for loops
+ * @tparam It The iterator type
+ */
+template <typename It>
+class IteratorRange {
+private:
+    It first;  ///< Beginning of the range
+    It last;   ///< End of the range
+
+public:
+    ARIEL_CONSTEXPR20 IteratorRange(It begin, It end) : first(std::move(begin)), last(std::move(end)) {}
+
+    ARIEL_CONSTEXPR20 const It& begin() const { return first; }
+    ARIEL_CONSTEXPR20 const It& end() const { return last; }
+};
+
 /**
  * @brief A generic container class that supports multiple iteration orders
  * 
@@ -23,60 +1760,1340 @@ namespace ariel {
  * - Middle out order: Starting from middle, alternating outward
  * 
  * @tparam T The type of elements stored in the container (default: int)
+ * @tparam Allocator Allocator for the elements and for every ordering buffer
+ *         (iterators, caches and scratch space) derived from the container
+ * @tparam InlineN Number of elements kept in-object before falling back to
+ *         the heap, both for the storage and for every ordering buffer
+ *         (default: 0, plain std::vector storage)
+ * @tparam Compare Strict weak ordering used by the sorted orders; descending
+ *         order uses its reverse (default: std::less<T>)
  */
-template <typename T = int>
+template <typename T = int, typename Allocator = std::allocator<T>, size_t InlineN = 0,
+          typename Compare = std::less<T>>
 class MyContainer {
+public:
+    using allocator_type = Allocator;  ///< Allocator used for all element buffers
+    using value_compare = Compare;     ///< Ordering of the sorted orders
+
+    /// Type of the element storage and of every ordering buffer
+    using storage_type = std::conditional_t<InlineN == 0, std::vector<T, Allocator>,
+                                            detail::SmallVector<T, InlineN, Allocator>>;
+
+    /// Type of the index permutations representing sorted orders
+    using permutation_type = detail::Permutation<Allocator, InlineN>;
+
 private:
-    std::vector<T> elements;  ///< Internal storage for container elements
+    /// Allocator rebound to another value type (for index and scratch buffers)
+    template <typename U>
+    using rebind_alloc = typename std::allocator_traits<Allocator>::template rebind_alloc<U>;
+
+    class Presorter;
+    class ScratchPool;
+
+    /// Flags marking the removed elements, by index before the removal
+    using tombstone_type = std::conditional_t<InlineN == 0, std::vector<uint8_t, rebind_alloc<uint8_t>>,
+                                              detail::SmallVector<uint8_t, InlineN, rebind_alloc<uint8_t>>>;
+
+    storage_type elements;            ///< Internal storage for container elements
+    permutation_type sorted_order{Allocator()};  ///< Indices of the elements in ascending order, valid if sorted_valid
+    bool sorted_valid = false;        ///< Whether sorted_order matches elements
+    bool prefix_valid = false;        ///< Whether sorted_order orders the first sorted_order.size() elements
+                                      ///< (once tombstones are dropped)
+    tombstone_type tombstones{rebind_alloc<uint8_t>(Allocator())};  ///< Elements removed since sorted_order was built
+    bool in_order = true;             ///< Whether elements are already in ascending order
+    bool stable = false;              ///< Whether equal elements keep insertion order in sorted orders
+    bool indexed = false;             ///< Whether counts is maintained
+    detail::CountIndex<T, Allocator> counts{Allocator()};  ///< Occurrences of each value, if indexed
+    bool eytzinger = false;           ///< Whether searches use search_layout
+    detail::EytzingerIndex<T, Allocator> search_layout{Allocator()};  ///< Breadth-first copy of the ascending order
+    size_t generation = 0;            ///< Incremented on every mutation
+    detail::IntrusivePtr<ScratchPool> scratch;  ///< Ordering buffers recycled between iterators
+    Compare compare;                  ///< Ordering of the sorted orders
+    detail::OwningPtr<Presorter> presorter;  ///< Background sorter, if enabled (declared last: joined first)
+
+    /// Whether moving the elements and caches into a new container cannot throw
+    static constexpr bool nothrow_move_constructible =
+        std::is_nothrow_move_constructible<storage_type>::value &&
+        std::is_nothrow_move_constructible<permutation_type>::value &&
+        std::is_nothrow_move_constructible<tombstone_type>::value &&
+        std::is_nothrow_move_constructible<detail::CountIndex<T, Allocator>>::value &&
+        std::is_nothrow_move_constructible<detail::EytzingerIndex<T, Allocator>>::value &&
+        std::is_nothrow_copy_constructible<Compare>::value;
+
+    /// Whether moving the elements and caches into an existing container cannot throw
+    static constexpr bool nothrow_move_assignable =
+        std::is_nothrow_move_assignable<storage_type>::value &&
+        std::is_nothrow_move_assignable<permutation_type>::value &&
+        std::is_nothrow_move_assignable<tombstone_type>::value &&
+        std::is_nothrow_move_assignable<detail::CountIndex<T, Allocator>>::value &&
+        std::is_nothrow_copy_assignable<Compare>::value;
+
+    /**
+     * @brief Lock the ordering cache if a background sorter shares it
+     * @return A lock holding the presorter mutex, or an empty lock
+     */
+    ARIEL_CONSTEXPR20 detail::OptionalLock lock_cache() const {
+        return detail::OptionalLock(presorter ? &presorter->mutex : nullptr);
+    }
+
+    /**
+     * @brief Record a mutation of the elements (cache lock must be held)
+     */
+    ARIEL_CONSTEXPR20 void invalidate_orders() {
+        sorted_valid = false;
+        ++generation;
+        if (presorter) {
+            presorter->touch();
+        }
+    }
+
+    /**
+     * @brief Stop the background sorter before the container is moved
+     * @return Its quiet period, or nothing if background sorting was off
+     */
+    ARIEL_CONSTEXPR20 std::optional<std::chrono::milliseconds> stop_background_sorting() noexcept {
+        std::optional<std::chrono::milliseconds> quiet_period;
+        if (presorter) {
+            quiet_period = presorter->quiet_period;
+            presorter.reset();
+        }
+        return quiet_period;
+    }
+
+    /**
+     * @brief Restart background sorting after a move
+     *
+     * Only a cache warm-up is lost if no thread can be started, so the
+     * failure is swallowed and the container sorts on demand instead.
+     *
+     * @param quiet_period Quiet period of the sorter the source had
+     */
+    void resume_background_sorting(std::chrono::milliseconds quiet_period) noexcept {
+        try {
+            enable_background_sorting(quiet_period);
+        } catch (...) {
+            presorter.reset();
+        }
+    }
+
+    /**
+     * @brief Leave a moved-from container empty and without caches
+     */
+    ARIEL_CONSTEXPR20 void clear_moved_from() noexcept {
+        elements.clear();
+        sorted_order.clear();
+        tombstones.clear();
+        indexed = false;
+        counts.clear();
+        eytzinger = false;
+        search_layout.clear();
+        sorted_valid = false;
+        prefix_valid = false;
+        in_order = true;
+        ++generation;
+    }
+
+    /**
+     * @brief Move the elements and caches of a container whose sorter is stopped
+     * @param other The container to move from
+     * @param quiet_period Quiet period of the sorter other had, if any
+     */
+    ARIEL_CONSTEXPR20 MyContainer(MyContainer&& other, std::optional<std::chrono::milliseconds> quiet_period)
+        noexcept(nothrow_move_constructible)
+        : elements(std::move(other.elements)), sorted_order(std::move(other.sorted_order)),
+          sorted_valid(other.sorted_valid), prefix_valid(other.prefix_valid), tombstones(std::move(other.tombstones)),
+          in_order(other.in_order), stable(other.stable), indexed(other.indexed), counts(std::move(other.counts)),
+          eytzinger(other.eytzinger), search_layout(std::move(other.search_layout)), generation(other.generation),
+          compare(other.compare) {
+        other.clear_moved_from();
+        if (quiet_period) {
+            resume_background_sorting(*quiet_period);
+        }
+    }
+
+    /**
+     * @brief Drop the elements removed since the last merge from the
+     *        cached order (cache lock must be held)
+     */
+    ARIEL_CONSTEXPR20 void apply_tombstones() {
+        if (!tombstones.empty()) {
+            sorted_order.drop_removed(tombstones);
+            tombstones.clear();
+        }
+    }
+
+    /**
+     * @brief Re-establish in_order after a removal or update put the
+     *        elements back in order (cache lock must be held)
+     *
+     * The one-comparison check of add() cannot notice this, so the elements
+     * are scanned up to their first descent. A warm cached order becomes the
+     * identity, which update() relies on while in_order holds.
+     */
+    ARIEL_CONSTEXPR20 void recheck_in_order() {
+        if (in_order) {
+            return;
+        }
+        if constexpr (detail::is_comparable<T, Compare>::value) {
+            in_order = std::is_sorted(elements.begin(), elements.end(), compare);
+        } else {
+            in_order = elements.size() <= 1;
+        }
+        if (in_order && sorted_valid) {
+            sorted_order.assign_identity(elements.size());
+        }
+    }
+
+    /**
+     * @brief Sort a range of elements by the container's comparator
+     *
+     * Strings under the default comparator are sorted by packed prefix keys
+     * and integers with a narrow value range by counting.
+     *
+     * @param first Beginning of the range
+     * @param last End of the range
+     * @param policy Execution policy
+     */
+    template <typename RandomIt>
+    ARIEL_CONSTEXPR20 void sort_range(RandomIt first, RandomIt last, const ExecutionPolicy& policy) const {
+        size_t n = static_cast<size_t>(last - first);
+        if constexpr (detail::has_prefix_key<T, Compare>::value) {
+            if (!detail::is_constant_evaluated() && n >= detail::prefix_key_threshold) {
+                detail::prefix_key_sort(first, last, elements.get_allocator(), policy);
+                return;
+            }
+        }
+        if constexpr (detail::has_counting_key<T, Compare>::value) {
+            if (!detail::is_constant_evaluated() && n >= detail::counting_sort_threshold) {
+                if (auto range = detail::counting_range(first, n)) {
+                    detail::counting_sort(first, n, *range, elements.get_allocator());
+                    return;
+                }
+            }
+        }
+        detail::parallel_sort(first, last, compare, policy);
+    }
+
+    /**
+     * @brief Compute the permutation listing values in ascending order
+     *
+     * Strings under the default comparator are sorted by packed prefix keys,
+     * and integers whose value range is no wider than their count by a
+     * histogram pass in O(n + range).
+     *
+     * @param order Receives the permutation
+     * @param values The values to order
+     * @param policy Execution policy
+     */
+    ARIEL_CONSTEXPR20 void sort_permutation(permutation_type& order, const storage_type& values,
+                                            const ExecutionPolicy& policy) const {
+        order.assign_identity(values.size());
+        order.visit([&](auto& indices) {
+            if constexpr (detail::has_prefix_key<T, Compare>::value) {
+                if (!detail::is_constant_evaluated() && indices.size() >= detail::prefix_key_threshold) {
+                    detail::prefix_key_sort_indices(values.begin(), indices.begin(), indices.end(),
+                                                    values.get_allocator(), policy);
+                    return;
+                }
+            }
+            if constexpr (detail::has_counting_key<T, Compare>::value) {
+                if (!detail::is_constant_evaluated() && indices.size() >= detail::counting_sort_threshold) {
+                    if (auto range = detail::counting_range(values.begin(), values.size())) {
+                        detail::counting_sort_indices(values.begin(), indices.begin(), values.size(), *range,
+                                                      values.get_allocator());
+                        return;
+                    }
+                }
+            }
+            auto buffer = std::decay_t<decltype(indices)>(indices.get_allocator());
+            sort_indices(indices.begin(), indices.end(), values, policy, buffer);
+        });
+    }
+
+    /**
+     * @brief Compare two values by index, breaking ties by index when stable
+     * @param values The values the indices refer to
+     * @param a Index of the first value
+     * @param b Index of the second value
+     * @return true if values[a] goes before values[b]
+     */
+    ARIEL_CONSTEXPR20 bool index_less(const storage_type& values, size_t a, size_t b) const {
+        if (compare(values[a], values[b])) {
+            return true;
+        }
+        return stable && a < b && !compare(values[b], values[a]);
+    }
+
+    /**
+     * @brief Sort element indices by comparing the values they refer to,
+     *        merging natural runs when there are few of them
+     * @param first Beginning of the indices
+     * @param last End of the indices
+     * @param values The values the indices refer to
+     * @param policy Execution policy
+     * @param buffer Merge buffer, allocated like the permutation holding the indices
+     */
+    template <typename IndexIt, typename Buffer>
+    ARIEL_CONSTEXPR20 void sort_indices(IndexIt first, IndexIt last, const storage_type& values,
+                                        const ExecutionPolicy& policy, Buffer& buffer) const {
+        auto less = [&](size_t a, size_t b) { return index_less(values, a, b); };
+        size_t n = static_cast<size_t>(last - first);
+        size_t max_runs = std::max<size_t>(2, n / detail::natural_run_length);
+        if (detail::is_constant_evaluated() || !detail::natural_merge_sort(first, n, less, max_runs, buffer)) {
+            detail::parallel_sort(first, last, less, policy);
+        }
+    }
+
+    /**
+     * @brief Extend a sorted permutation of the first values to all of them
+     *
+     * Only the pending values added since are sorted, in O(k log k), and
+     * then merged with the sorted base in O(n + k). The merge buffer comes
+     * from the container's allocator (or inline storage) and holds at most
+     * the pending indices.
+     *
+     * @param order Ascending permutation of values[0, order.size())
+     * @param values The values to order
+     * @param policy Execution policy used to sort the pending values
+     */
+    ARIEL_CONSTEXPR20 void merge_pending(permutation_type& order, const storage_type& values,
+                                         const ExecutionPolicy& policy) const {
+        size_t base = order.size();
+        order.extend(values.size());
+        order.visit([&](auto& indices) {
+            auto middle = indices.begin() + static_cast<std::ptrdiff_t>(base);
+            auto buffer = std::decay_t<decltype(indices)>(indices.get_allocator());
+            sort_indices(middle, indices.end(), values, policy, buffer);
+            auto less = [&](size_t a, size_t b) { return index_less(values, a, b); };
+            if (detail::is_constant_evaluated()) {
+                std::sort(indices.begin(), indices.end(), less);
+            } else {
+                detail::merge_adjacent(indices.begin(), middle, indices.end(), less, buffer);
+            }
+        });
+    }
+
+    /**
+     * @brief Bring an ascending permutation up to date with the elements
+     * @param order The permutation; on entry the cached order if prefix_valid
+     * @param values The values to order
+     * @param ascending Whether values are already in ascending order (see in_order)
+     * @param prefix Whether order orders a prefix of values
+     * @param policy Execution policy used for sorting
+     */
+    ARIEL_CONSTEXPR20 void complete_order(permutation_type& order, const storage_type& values, bool ascending,
+                                          bool prefix, const ExecutionPolicy& policy) const {
+        if (ascending) {
+            order.assign_identity(values.size());
+        } else if (prefix && !order.empty()) {
+            merge_pending(order, values, policy);
+        } else {
+            sort_permutation(order, values, policy);
+        }
+    }
+
+    /**
+     * @brief Get the ascending order, sorting and caching it if needed
+     * @param policy Execution policy used if a sort is needed
+     * @return The cached permutation listing the elements in ascending order
+     */
+    ARIEL_CONSTEXPR20 const permutation_type& sorted_view(const ExecutionPolicy& policy = seq) {
+        auto lock = lock_cache();
+        if (!sorted_valid) {
+            apply_tombstones();
+            complete_order(sorted_order, elements, in_order, prefix_valid, policy);
+            sorted_valid = prefix_valid = true;
+            in_order = in_order || sorted_order.is_identity();  // the sort found a single run
+        }
+        return sorted_order;
+    }
+
+    /**
+     * @brief Binary search the ascending order
+     * @param before Predicate on elements, true for a prefix of the ascending order
+     * @return The number of elements in ascending order for which before is true
+     */
+    template <typename Before>
+    ARIEL_CONSTEXPR20 size_t ascending_partition_point(Before before) {
+        if (eytzinger) {
+            if (!search_layout.current(generation)) {
+                const permutation_type& sorted = sorted_view();
+                search_layout.build(sorted.size(), [&](size_t pos) -> const T& { return elements[sorted[pos]]; },
+                                    generation);
+            }
+            return search_layout.partition_point(before);
+        }
+        return sorted_view().visit([&](const auto& indices) {
+            return detail::partition_point(indices.size(),
+                                           [&](size_t pos) { return before(elements[indices[pos]]); });
+        });
+    }
+
+    /**
+     * @brief Get the scratch pool a new iterator should borrow its buffer from
+     * @param end Whether the iterator is an end iterator
+     * @return The pool (created on first use with the container's allocator),
+     *         or null if the ordering needs no heap buffer at all or during
+     *         constant evaluation
+     */
+    ARIEL_CONSTEXPR20 detail::IntrusivePtr<ScratchPool> scratch_pool(bool end) {
+        if (end || elements.size() <= InlineN || detail::is_constant_evaluated()) {
+            return detail::IntrusivePtr<ScratchPool>();
+        }
+        if (!scratch) {
+            scratch = ScratchPool::create(get_allocator());
+        }
+        return scratch;
+    }
+
+    /**
+     * @brief Get the cached ascending order without computing it
+     * @return The cached permutation, or nullptr if the cache is cold
+     */
+    ARIEL_CONSTEXPR20 const permutation_type* cached_sorted() const {
+        auto lock = lock_cache();
+        return sorted_valid ? &sorted_order : nullptr;
+    }
+
+    /**
+     * @brief Get the permutation an order's source indices refer to
+     *
+     * Const operations read the ordering cache when it is warm but never
+     * fill it, so concurrent const calls stay safe.
+     *
+     * @param order The iteration order
+     * @param sorted Permutation that receives the ascending order if needed
+     * @param policy Execution policy used for sorting
+     * @return The ascending permutation for sorted orders, nullptr otherwise
+     */
+    ARIEL_CONSTEXPR20 const permutation_type* ordered_source(Order order, permutation_type& sorted,
+                                                             const ExecutionPolicy& policy) const {
+        if (!detail::is_sorted_order(order)) {
+            return nullptr;
+        }
+        bool prefix = false;
+        {
+            auto lock = lock_cache();
+            if (sorted_valid) {
+                return &sorted_order;
+            }
+            if (prefix_valid && !in_order) {
+                sorted = sorted_order;
+                if (!tombstones.empty()) {
+                    sorted.drop_removed(tombstones);
+                }
+                prefix = true;
+            }
+        }
+        complete_order(sorted, elements, in_order, prefix, policy);
+        return &sorted;
+    }
+
+    /**
+     * @brief Get the element visited at a position of an order
+     * @param order The iteration order
+     * @param sorted The order's permutation, as returned by ordered_source
+     * @param n Number of elements
+     * @param pos Position within the iteration
+     * @return The element
+     */
+    ARIEL_CONSTEXPR20 const T& element_at(Order order, const permutation_type* sorted, size_t n, size_t pos) const {
+        size_t index = detail::source_index(order, n, pos);
+        return elements[sorted ? (*sorted)[index] : index];
+    }
+
+    /**
+     * @brief Remove matching elements (see remove_if), without touching the cache
+     * @param pred Predicate returning true for elements to remove
+     * @param policy Execution policy
+     * @return The number of removed elements
+     */
+    template <typename Predicate>
+    ARIEL_CONSTEXPR20 size_t compact_if(Predicate& pred, const ExecutionPolicy& policy) {
+        size_t n = elements.size();
+        size_t chunks = detail::chunk_count(n, policy);
+        if (chunks <= 1) {
+            auto survivors_end = std::remove_if(elements.begin(), elements.end(), pred);
+            size_t removed = static_cast<size_t>(elements.end() - survivors_end);
+            elements.erase(survivors_end, elements.end());
+            return removed;
+        }
+
+        // Compact every chunk in place; offsets[i + 1] holds chunk i's survivor count
+        std::vector<size_t, rebind_alloc<size_t>> offsets(chunks + 1, 0, rebind_alloc<size_t>(get_allocator()));
+        detail::parallel_chunks(n, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            auto first = elements.begin() + begin;
+            offsets[chunk + 1] = static_cast<size_t>(
+                std::remove_if(first, elements.begin() + end, pred) - first);
+        });
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            offsets[chunk + 1] += offsets[chunk];
+        }
+        size_t survivors = offsets[chunks];
+        if (survivors == n) {
+            return 0;
+        }
+
+        if constexpr (std::is_default_constructible<T>::value) {
+            // Destinations of one chunk may overlap sources of an earlier one,
+            // so move into fresh storage to let every chunk proceed independently
+            storage_type compacted(survivors, elements.get_allocator());
+            detail::parallel_chunks(n, chunks, [&](size_t chunk, size_t begin, size_t) {
+                auto first = elements.begin() + begin;
+                std::move(first, first + (offsets[chunk + 1] - offsets[chunk]),
+                          compacted.begin() + offsets[chunk]);
+            });
+            elements.swap(compacted);
+        } else {
+            for (size_t chunk = 1; chunk < chunks; ++chunk) {
+                auto first = elements.begin() + chunk * n / chunks;
+                std::move(first, first + (offsets[chunk + 1] - offsets[chunk]),
+                          elements.begin() + offsets[chunk]);
+            }
+            elements.erase(elements.begin() + survivors, elements.end());
+        }
+        return n - survivors;
+    }
+
+    /**
+     * @brief Remove matching elements and maintain the ordering cache
+     *        (see remove_if), leaving the hash index to the caller
+     * @param pred Predicate returning true for elements to remove
+     * @param policy Execution policy
+     * @return The number of removed elements
+     */
+    template <typename Predicate>
+    ARIEL_CONSTEXPR20 size_t erase_matching(Predicate& pred, const ExecutionPolicy& policy) {
+        auto lock = lock_cache();
+        if (!prefix_valid || in_order || elements.empty()) {
+            size_t removed = compact_if(pred, policy);
+            if (removed > 0) {
+                invalidate_orders();
+                prefix_valid = false;
+                recheck_in_order();
+            }
+            return removed;
+        }
+
+        // Keep the cached order: mark removed elements by their current index
+        // (remove_if tests every element before anything is moved over it)
+        apply_tombstones();
+        tombstones.resize(elements.size());
+        const T* first = &elements[0];
+        auto marking = [&](const T& value) {
+            if (pred(value)) {
+                tombstones[static_cast<size_t>(&value - first)] = 1;
+                return true;
+            }
+            return false;
+        };
+        size_t removed = compact_if(marking, policy);
+        if (removed > 0) {
+            invalidate_orders();
+            recheck_in_order();
+        } else {
+            tombstones.clear();
+        }
+        return removed;
+    }
+
+    /**
+     * @brief Recount every value into the hash index, if enabled
+     */
+    ARIEL_CONSTEXPR20 void rebuild_counts() {
+        if constexpr (detail::is_hashable<T>::value) {
+            if (indexed) {
+                counts.clear();
+                for (const T& element : elements) {
+                    counts.add(element);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Switch stable ordering on or off
+     *
+     * The background sorter reads the mode while sorting outside the lock,
+     * so it is stopped for the switch and restarted afterwards.
+     *
+     * @param on Whether equal elements should keep insertion order
+     */
+    void set_stable_ordering(bool on) {
+        if (stable == on) {
+            return;
+        }
+        std::optional<std::chrono::milliseconds> quiet_period;
+        if (presorter) {
+            quiet_period = presorter->quiet_period;
+            disable_background_sorting();
+        }
+        stable = on;
+        if (on) {
+            sorted_valid = prefix_valid = false;
+            tombstones.clear();
+            ++generation;
+        }
+        if (quiet_period) {
+            enable_background_sorting(*quiet_period);
+        }
+    }
+
+    /**
+     * @brief Validate a range of iteration positions
+     * @param first First position (inclusive)
+     * @param last Last position (exclusive)
+     * @throws std::out_of_range if first > last or last > size()
+     */
+    void check_positions(size_t first, size_t last) const {
+        if (first > last || last > elements.size()) {
+            throw std::out_of_range("Position range out of bounds");
+        }
+    }
 
 public:
     // Forward declarations of iterator classes
-    class AscendingIterator;
-    class DescendingIterator;
-    class SideCrossIterator;
-    class ReverseIterator;
-    class OrderIterator;
-    class MiddleOutIterator;
+    template <typename Policy>
+    class Iterator;
+    class GroupIterator;
+    class RangeIterator;
+    class OrderStream;
+
+    using AscendingIterator = Iterator<OrderPolicy<Order::Ascending>>;
+    using DescendingIterator = Iterator<OrderPolicy<Order::Descending>>;
+    using SideCrossIterator = Iterator<OrderPolicy<Order::SideCross>>;
+    using ReverseIterator = Iterator<OrderPolicy<Order::Reverse>>;
+    using OrderIterator = Iterator<OrderPolicy<Order::Normal>>;
+    using MiddleOutIterator = Iterator<OrderPolicy<Order::MiddleOut>>;
 
     /**
      * @brief Default constructor - creates an empty container
      */
     MyContainer() = default;
 
+    /**
+     * @brief Create an empty container using the given allocator
+     * @param alloc Allocator for the elements and all ordering buffers
+     */
+    ARIEL_CONSTEXPR20 explicit MyContainer(const Allocator& alloc)
+        : elements(alloc), sorted_order(alloc), tombstones(rebind_alloc<uint8_t>(alloc)), counts(alloc),
+          search_layout(alloc) {}
+
+    /**
+     * @brief Create an empty container ordered by the given comparator
+     * @param comp Comparator used by the sorted orders
+     * @param alloc Allocator for the elements and all ordering buffers
+     */
+    ARIEL_CONSTEXPR20 explicit MyContainer(const Compare& comp, const Allocator& alloc = Allocator())
+        : elements(alloc), sorted_order(alloc), tombstones(rebind_alloc<uint8_t>(alloc)), counts(alloc),
+          search_layout(alloc), compare(comp) {}
+
+    /**
+     * @brief Copy constructor - copies the elements and the ordering cache
+     *
+     * Background sorting is enabled on the copy if it was enabled on the source.
+     *
+     * @param other The container to copy
+     */
+    ARIEL_CONSTEXPR20 MyContainer(const MyContainer& other)
+        : MyContainer(other.compare, std::allocator_traits<Allocator>::select_on_container_copy_construction(
+              other.get_allocator())) {
+        auto lock = other.lock_cache();
+        elements = other.elements;
+        sorted_order = other.sorted_order;
+        sorted_valid = other.sorted_valid;
+        prefix_valid = other.prefix_valid;
+        tombstones = other.tombstones;
+        in_order = other.in_order;
+        stable = other.stable;
+        indexed = other.indexed;
+        counts = other.counts;
+        eytzinger = other.eytzinger;
+        if (other.presorter) {
+            lock.unlock();
+            enable_background_sorting(other.presorter->quiet_period);
+        }
+    }
+
+    /**
+     * @brief Move constructor - takes over the elements, the ordering cache
+     *        and the background sorting mode of the source
+     *
+     * Does not throw for the default storage, so containers of containers
+     * move rather than copy their elements when they grow.
+     *
+     * @param other The container to move from
+     */
+    ARIEL_CONSTEXPR20 MyContainer(MyContainer&& other) noexcept(nothrow_move_constructible)
+        : MyContainer(std::move(other), other.stop_background_sorting()) {}
+
+    /**
+     * @brief Copy assignment
+     * @param other The container to copy
+     * @return Reference to this container
+     */
+    ARIEL_CONSTEXPR20 MyContainer& operator=(const MyContainer& other) {
+        if (this != &other) {
+            *this = MyContainer(other);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Move assignment
+     *
+     * Background sorter threads refer to their owning container, so both
+     * sorters are stopped and a new one is started here if the source had one.
+     *
+     * @param other The container to move from
+     * @return Reference to this container
+     */
+    ARIEL_CONSTEXPR20 MyContainer& operator=(MyContainer&& other) noexcept(nothrow_move_assignable) {
+        if (this != &other) {
+            std::optional<std::chrono::milliseconds> quiet_period = other.stop_background_sorting();
+            stop_background_sorting();
+            elements = std::move(other.elements);
+            sorted_order = std::move(other.sorted_order);
+            compare = other.compare;
+            sorted_valid = other.sorted_valid;
+            prefix_valid = other.prefix_valid;
+            tombstones = std::move(other.tombstones);
+            in_order = other.in_order;
+            stable = other.stable;
+            indexed = other.indexed;
+            counts = std::move(other.counts);
+            eytzinger = other.eytzinger;
+            search_layout.clear();
+            ++generation;
+            other.clear_moved_from();
+            if (quiet_period) {
+                resume_background_sorting(*quiet_period);
+            }
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Get the allocator used by the container
+     * @return A copy of the allocator
+     */
+    ARIEL_CONSTEXPR20 allocator_type get_allocator() const {
+        return elements.get_allocator();
+    }
+
+    /**
+     * @brief Get the comparator used by the sorted orders
+     * @return A copy of the comparator
+     */
+    ARIEL_CONSTEXPR20 value_compare value_comp() const {
+        return compare;
+    }
+
     /**
      * @brief Add an element to the container
+     *
+     * An element not less than the current maximum extends a warm ascending
+     * order in place. Any other element leaves the cached order covering the
+     * elements before it; the elements added since are sorted and merged in
+     * when a sorted order is next needed.
+     *
      * @param element The element to add
      */
-    void add(const T& element) {
+    ARIEL_CONSTEXPR20 void add(const T& element) {
+        auto lock = lock_cache();
+        bool extends_order = false;
+        if constexpr (detail::is_comparable<T, Compare>::value) {
+            in_order = in_order && (elements.empty() || !compare(element, elements.back()));
+            extends_order = sorted_valid &&
+                            (sorted_order.empty() || !compare(element, elements[sorted_order[sorted_order.size() - 1]]));
+        } else {
+            in_order = elements.empty();
+        }
         elements.push_back(element);
+        if constexpr (detail::is_hashable<T>::value) {
+            if (indexed) {
+                counts.add(element);
+            }
+        }
+        if (extends_order) {
+            sorted_order.extend(elements.size());
+            ++generation;
+        } else {
+            invalidate_orders();
+        }
+    }
+
+    /**
+     * @brief Check whether the elements are stored in ascending order
+     *
+     * Tracked with one comparison per add(), and while tracked as true the
+     * sorted orders need no sorting. Removals and update(), which can put
+     * unordered elements back in order, recheck it by scanning up to the
+     * first descent, and a sort that finds a single run sets it again.
+     *
+     * @return true if insertion order is already ascending
+     */
+    ARIEL_CONSTEXPR20 bool is_sorted() const {
+        auto lock = lock_cache();
+        return in_order;
+    }
+
+    /**
+     * @brief Rebuild the sorted orders on a background thread after mutation bursts
+     *
+     * Once no add()/remove() has happened for quiet_period, a worker thread
+     * sorts a snapshot of the elements and publishes it to the ordering
+     * cache (unless the container changed meanwhile), so the next ascending,
+     * descending or side cross traversal starts without sorting. While
+     * enabled, mutations and cache accesses synchronize with the worker.
+     *
+     * @param quiet_period Time without mutations before rebuilding
+     */
+    void enable_background_sorting(std::chrono::milliseconds quiet_period = std::chrono::milliseconds(50)) {
+        disable_background_sorting();
+        presorter.reset(new Presorter(quiet_period));
+        std::lock_guard<std::mutex> lock(presorter->mutex);
+        if (!sorted_valid) {
+            presorter->touch();
+        }
+        presorter->worker = std::thread(&Presorter::run, presorter.get(), this);
+    }
+
+    /**
+     * @brief Stop the background sorter (the cache is kept)
+     */
+    void disable_background_sorting() {
+        presorter.reset();
+    }
+
+    /**
+     * @brief Check whether background sorting is enabled
+     * @return true if a background sorter is running
+     */
+    bool background_sorting() const {
+        return static_cast<bool>(presorter);
+    }
+
+    /**
+     * @brief Check whether the sorted orders are cached
+     * @return true if ascending, descending and side cross traversals can start without sorting
+     */
+    ARIEL_CONSTEXPR20 bool orders_cached() const {
+        return cached_sorted() != nullptr;
+    }
+
+    /**
+     * @brief Keep equal elements in insertion order in the sorted orders
+     *
+     * Ascending traversals then list equal elements in the order they were
+     * added (descending ones, being its reverse, in the opposite order), at
+     * the cost of a second comparison on ties. A cached order computed
+     * without this guarantee is discarded.
+     */
+    void enable_stable_ordering() {
+        set_stable_ordering(true);
+    }
+
+    /**
+     * @brief Allow equal elements in any order in the sorted orders (the default)
+     */
+    void disable_stable_ordering() {
+        set_stable_ordering(false);
+    }
+
+    /**
+     * @brief Check whether the sorted orders keep equal elements in insertion order
+     * @return true if stable ordering is enabled
+     */
+    bool stable_ordering() const {
+        return stable;
     }
 
 
     /**
      * @brief Remove all instances of an element from the container
+     *
+     * With the hash index enabled, an absent element is reported without
+     * scanning the elements.
+     *
      * @param element The element to remove
+     * @param policy Execution policy (default: sequential)
      * @throws std::runtime_error if the element is not found
      */
-    void remove(const T& element) {
-        size_t initial_size = elements.size();
-        elements.erase(
-            std::remove(elements.begin(), elements.end(), element),
-            elements.end()
-        );
-        
-        if (elements.size() == initial_size) {
+    ARIEL_CONSTEXPR20 void remove(const T& element, const ExecutionPolicy& policy = seq) {
+        bool absent = false;
+        if constexpr (detail::is_hashable<T>::value) {
+            absent = indexed && counts.count(element) == 0;
+        }
+        auto matches = [&element](const T& value) { return value == element; };
+        size_t removed = absent ? 0 : erase_matching(matches, policy);
+
+        if (removed == 0) {
             throw std::runtime_error("Element not found in container");
         }
+        if constexpr (detail::is_hashable<T>::value) {
+            if (indexed) {
+                counts.erase(element);
+            }
+        }
+    }
+
+    /**
+     * @brief Remove all elements matching a predicate, keeping insertion order
+     *
+     * With a parallel policy the elements are split into chunks which are
+     * filtered concurrently; the per-chunk survivor counts are prefix-summed
+     * into destination offsets and the survivors are then moved to their
+     * final positions concurrently. The predicate must be safe to call from
+     * several threads at once.
+     *
+     * A cached ascending order is kept: the removed elements are recorded as
+     * tombstones and dropped from it at the next merge, together with the
+     * elements added since (see add), instead of sorting from scratch.
+     *
+     * @param pred Predicate returning true for elements to remove
+     * @param policy Execution policy (default: sequential)
+     * @return The number of removed elements
+     */
+    template <typename Predicate>
+    ARIEL_CONSTEXPR20 size_t remove_if(Predicate pred, const ExecutionPolicy& policy = seq) {
+        size_t removed = erase_matching(pred, policy);
+        if (removed > 0) {
+            rebuild_counts();
+        }
+        return removed;
+    }
+
+    /**
+     * @brief Remove the single element an iterator points to
+     *
+     * Unlike remove(), other elements equal to it are kept. A warm ordering
+     * cache stays warm: the element's index is dropped from it in one pass
+     * instead of sorting again.
+     *
+     * As with std::vector::erase, the returned iterator continues the same
+     * traversal at the element after the erased one, so elements can be
+     * erased while walking any order; other iterators of the order, and its
+     * end iterator, are invalidated. Range view iterators further along the
+     * walk, including the view's end, stay valid.
+     *
+     * @param it Iterator of any order, or of a range view, of this container
+     * @return Iterator to the next element of the same traversal
+     * @throws std::out_of_range if it is an end iterator or belongs to another container
+     */
+    template <typename It>
+    ARIEL_CONSTEXPR20 It erase(It it) {
+        auto lock = lock_cache();
+        size_t index = index_of(it);
+        if constexpr (detail::is_hashable<T>::value) {
+            if (indexed) {
+                counts.subtract(elements[index]);
+            }
+        }
+        if (sorted_valid) {
+            sorted_order.erase_index(index);
+            ++generation;
+        } else {
+            if (prefix_valid && !in_order) {
+                apply_tombstones();
+                tombstones.resize(elements.size());
+                tombstones[index] = 1;
+            } else {
+                prefix_valid = false;
+            }
+            invalidate_orders();
+        }
+        elements.erase(elements.begin() + static_cast<std::ptrdiff_t>(index));
+        recheck_in_order();
+        skip_erased(it, index);
+        return it;
+    }
+
+    /**
+     * @brief Replace the element an iterator points to, keeping its place
+     *        in insertion order
+     *
+     * A warm ascending order is repaired by moving the element's entry from
+     * its old to its new sorted position, in O(log n) comparisons plus the
+     * distance moved. Sorted-order and range view iterators know the old
+     * position; from an insertion-order iterator it is found by binary
+     * search, which without stable ordering also scans the elements equal
+     * to the old value. The iterator, like all others, is invalidated.
+     *
+     * @param it Iterator of any order, or of a range view, of this container
+     * @param value The new value
+     * @throws std::out_of_range if it is an end iterator or belongs to another container
+     */
+    template <typename It>
+    ARIEL_CONSTEXPR20 void update(const It& it, const T& value) {
+        auto lock = lock_cache();
+        size_t index = index_of(it);
+        size_t n = elements.size();
+        if constexpr (detail::is_hashable<T>::value) {
+            if (indexed) {
+                counts.subtract(elements[index]);
+                counts.add(value);
+            }
+        }
+        size_t old_position = sorted_valid && !in_order ? sorted_position(index, position_hint(it)) : 0;
+        elements[index] = value;
+
+        bool was_in_order = in_order;
+        if constexpr (detail::is_comparable<T, Compare>::value) {
+            in_order = in_order && (index == 0 || !compare(value, elements[index - 1])) &&
+                       (index + 1 == n || !compare(elements[index + 1], value));
+        } else {
+            in_order = n <= 1;
+        }
+        if (!sorted_valid) {
+            // A pending element is simply sorted at the next merge; one in the sorted base is not
+            if (!tombstones.empty() || index < sorted_order.size()) {
+                prefix_valid = false;
+            }
+            invalidate_orders();
+            if (!was_in_order) {
+                recheck_in_order();
+            }
+            return;
+        }
+        ++generation;
+        if (in_order) {
+            return;  // the cached order is the identity and stays so
+        }
+        if (was_in_order) {
+            old_position = index;  // the cached order was the identity
+        }
+        // Position among the other entries, which are still in order
+        size_t new_position = detail::partition_point(n - 1, [&](size_t pos) {
+            return index_less(elements, sorted_order[pos < old_position ? pos : pos + 1], index);
+        });
+        sorted_order.visit([&](auto& indices) {
+            auto entry = indices.begin() + static_cast<std::ptrdiff_t>(old_position);
+            auto target = indices.begin() + static_cast<std::ptrdiff_t>(new_position);
+            if (new_position < old_position) {
+                std::rotate(target, entry, entry + 1);
+            } else {
+                std::rotate(entry, entry + 1, target + 1);
+            }
+        });
+        if (!was_in_order) {
+            recheck_in_order();
+        }
+    }
+
+    /**
+     * @brief Maintain a hash index of how often each value occurs
+     *
+     * The index is a flat open-addressing table updated by add() and
+     * remove(), so that remove() of an absent value returns without a scan
+     * and, under the default comparator, contains() and count() take O(1)
+     * expected time instead of a binary search. remove_if() rebuilds it.
+     * Requires std::hash<T> and operator== (the equality remove() uses).
+     */
+    void enable_hash_index() {
+        static_assert(detail::is_hashable<T>::value,
+                      "the hash index needs std::hash<T>, operator== and a default constructible T");
+        if (!indexed) {
+            indexed = true;
+            rebuild_counts();
+        }
+    }
+
+    /**
+     * @brief Answer binary search queries from an Eytzinger copy of the ascending order
+     *
+     * lower_bound, upper_bound, range, count and contains then search a
+     * copy of the sorted elements laid out breadth-first, with the next
+     * levels prefetched, instead of chasing the ascending permutation into
+     * the elements. This pays off for repeated queries on containers larger
+     * than the CPU caches. The copy (one T and one index per element) is
+     * rebuilt by the first query after each mutation.
+     */
+    void enable_eytzinger_search() {
+        eytzinger = true;
+    }
+
+    /**
+     * @brief Search the ascending permutation directly and free the Eytzinger copy
+     */
+    void disable_eytzinger_search() {
+        eytzinger = false;
+        search_layout.clear();
+    }
+
+    /**
+     * @brief Check whether queries use the Eytzinger layout
+     * @return true if enable_eytzinger_search() is in effect
+     */
+    bool eytzinger_search() const {
+        return eytzinger;
+    }
+
+    /**
+     * @brief Drop the hash index and its memory
+     */
+    void disable_hash_index() {
+        indexed = false;
+        counts.clear();
+    }
+
+    /**
+     * @brief Check whether the hash index is maintained
+     * @return true if enable_hash_index() is in effect
+     */
+    bool hash_index() const {
+        return indexed;
     }
 
     /**
      * @brief Get the number of elements in the container
      * @return The size of the container
      */
-    size_t size() const {
+    ARIEL_CONSTEXPR20 size_t size() const {
         return elements.size();
     }
 
+    /**
+     * @brief Find the first position in ascending order whose element is
+     *        not less than a value
+     *
+     * Binary searches the cached ascending order (sorting it first if the
+     * cache is cold), in O(log n) comparisons. Positions can be passed to
+     * for_each and transform_reduce with Order::Ascending.
+     *
+     * @param value The value to search for
+     * @return The number of elements less than value
+     */
+    ARIEL_CONSTEXPR20 size_t lower_bound(const T& value) {
+        return ascending_partition_point([&](const T& element) { return compare(element, value); });
+    }
+
+    /**
+     * @brief Find the first position in ascending order whose element is
+     *        greater than a value (see lower_bound)
+     * @param value The value to search for
+     * @return The number of elements not greater than value
+     */
+    ARIEL_CONSTEXPR20 size_t upper_bound(const T& value) {
+        return ascending_partition_point([&](const T& element) { return !compare(value, element); });
+    }
+
+    /**
+     * @brief Find the positions in ascending order of the elements in [low, high)
+     * @param low Smallest value included
+     * @param high Smallest value above the range
+     * @return The first position and the position after the last one
+     *         (equal if no element lies in the range)
+     */
+    ARIEL_CONSTEXPR20 std::pair<size_t, size_t> range(const T& low, const T& high) {
+        size_t first = lower_bound(low);
+        return {first, std::max(first, lower_bound(high))};
+    }
+
+    /**
+     * @brief Get the elements in [low, high) in ascending order
+     *
+     * The view reads the cached ascending order in place: only the two
+     * bounds are searched for, nothing is copied. Like iterators, the view
+     * is invalidated by any mutation of the container.
+     *
+     * @param low Smallest value included
+     * @param high Smallest value above the range
+     * @return Range of RangeIterator over the elements
+     */
+    ARIEL_CONSTEXPR20 IteratorRange<RangeIterator> ascending_range(const T& low, const T& high) {
+        auto [first, last] = range(low, high);
+        const permutation_type& sorted = sorted_view();
+        return IteratorRange<RangeIterator>(RangeIterator(elements, sorted, first, false),
+                                            RangeIterator(elements, sorted, last, false));
+    }
+
+    /**
+     * @brief Get the elements in (low, high] in descending order
+     *        (the mirror image of ascending_range, see there)
+     * @param high Largest value included
+     * @param low Largest value below the range
+     * @return Range of RangeIterator over the elements
+     */
+    ARIEL_CONSTEXPR20 IteratorRange<RangeIterator> descending_range(const T& high, const T& low) {
+        size_t first = upper_bound(low);
+        size_t last = std::max(first, upper_bound(high));
+        const permutation_type& sorted = sorted_view();
+        return IteratorRange<RangeIterator>(RangeIterator(elements, sorted, last, true),
+                                            RangeIterator(elements, sorted, first, true));
+    }
+
+    /**
+     * @brief Count the elements equal to a value, in O(log n)
+     *        (O(1) expected with the hash index under the default comparator)
+     * @param value The value to count
+     * @return The number of elements neither less nor greater than value
+     */
+    ARIEL_CONSTEXPR20 size_t count(const T& value) {
+        if constexpr (detail::is_hashable<T>::value && detail::is_default_less<T, Compare>::value) {
+            if (indexed) {
+                return counts.count(value);
+            }
+        }
+        return upper_bound(value) - lower_bound(value);
+    }
+
+    /**
+     * @brief Check whether an element equal to a value is present, in O(log n)
+     *        (O(1) expected with the hash index under the default comparator)
+     * @param value The value to look for
+     * @return true if some element is neither less nor greater than value
+     */
+    ARIEL_CONSTEXPR20 bool contains(const T& value) {
+        if constexpr (detail::is_hashable<T>::value && detail::is_default_less<T, Compare>::value) {
+            if (indexed) {
+                return counts.count(value) != 0;
+            }
+        }
+        size_t first = lower_bound(value);
+        return first < elements.size() && !compare(value, elements[sorted_order[first]]);
+    }
+
+    /**
+     * @brief Write the elements in the given iteration order to a buffer
+     *
+     * Every output position is computed independently from its source
+     * index, so the copy is split across threads according to the policy.
+     * Sorted orders reuse the cached order, or the in-order flag, or merge
+     * the elements added since the cached order was built; only without
+     * any of these is a copy of the elements sorted (also in parallel).
+     *
+     * @param order The iteration order to materialize
+     * @param out Random access iterator to a buffer of at least size() elements
+     * @param policy Execution policy (default: sequential)
+     */
+    template <typename RandomIt>
+    ARIEL_CONSTEXPR20 void materialize(Order order, RandomIt out, const ExecutionPolicy& policy = seq) const {
+        size_t n = elements.size();
+        if (n == 0) {
+            return;
+        }
+        bool cold = false;
+        {
+            auto lock = lock_cache();
+            cold = !sorted_valid && !prefix_valid && !in_order;
+        }
+        if (order == Order::Ascending && !stable && cold) {
+            // Sorting copies of the values loses track of which equal element came first
+            detail::parallel_for(n, policy, [&](size_t begin, size_t end) {
+                std::copy(elements.begin() + begin, elements.begin() + end, out + begin);
+            });
+            sort_range(out, out + n, policy);
+            return;
+        }
+        permutation_type sorted(elements.get_allocator());
+        const permutation_type* source = ordered_source(order, sorted, policy);
+        detail::parallel_for(n, policy, [&](size_t begin, size_t end) {
+            for (size_t pos = begin; pos < end; ++pos) {
+                out[pos] = element_at(order, source, n, pos);
+            }
+        });
+    }
+
+    /**
+     * @brief Apply a function to every element in the given iteration order
+     * @param order The iteration order
+     * @param f Callable taking a const reference to an element
+     * @param policy Execution policy (default: sequential)
+     */
+    template <typename F>
+    void for_each(Order order, F f, const ExecutionPolicy& policy = seq) const {
+        for_each(order, 0, elements.size(), f, policy);
+    }
+
+    /**
+     * @brief Apply a function to the elements at positions [first, last)
+     *        of the given iteration order
+     *
+     * The position range is split into contiguous chunks, one per thread.
+     * Within a chunk elements are visited in iteration order; with more
+     * than one thread f must be safe to call concurrently.
+     *
+     * @param order The iteration order
+     * @param first First position (inclusive)
+     * @param last Last position (exclusive)
+     * @param f Callable taking a const reference to an element
+     * @param policy Execution policy (default: sequential)
+     * @throws std::out_of_range if the position range is invalid
+     */
+    template <typename F>
+    void for_each(Order order, size_t first, size_t last, F f, const ExecutionPolicy& policy = seq) const {
+        check_positions(first, last);
+        size_t n = elements.size();
+        permutation_type sorted(elements.get_allocator());
+        const permutation_type* source = ordered_source(order, sorted, policy);
+        detail::parallel_for(last - first, policy, [&](size_t begin, size_t end) {
+            for (size_t pos = first + begin; pos < first + end; ++pos) {
+                f(element_at(order, source, n, pos));
+            }
+        });
+    }
+
+    /**
+     * @brief Transform every element and reduce the results in the given
+     *        iteration order
+     * @param order The iteration order
+     * @param init Initial value of the reduction
+     * @param reduce Associative binary operation combining two results
+     * @param transform Callable mapping an element to a result
+     * @param policy Execution policy (default: sequential)
+     * @return The reduced value
+     */
+    template <typename R, typename Reduce, typename Transform>
+    R transform_reduce(Order order, R init, Reduce reduce, Transform transform,
+                       const ExecutionPolicy& policy = seq) const {
+        return transform_reduce(order, 0, elements.size(), init, reduce, transform, policy);
+    }
+
+    /**
+     * @brief Transform and reduce the elements at positions [first, last)
+     *        of the given iteration order
+     *
+     * Each thread reduces one contiguous chunk of positions; the partial
+     * results are then combined in position order, so reduce only needs to
+     * be associative, not commutative.
+     *
+     * @param order The iteration order
+     * @param first First position (inclusive)
+     * @param last Last position (exclusive)
+     * @param init Initial value of the reduction
+     * @param reduce Associative binary operation combining two results
+     * @param transform Callable mapping an element to a result
+     * @param policy Execution policy (default: sequential)
+     * @return The reduced value
+     * @throws std::out_of_range if the position range is invalid
+     */
+    template <typename R, typename Reduce, typename Transform>
+    R transform_reduce(Order order, size_t first, size_t last, R init, Reduce reduce,
+                       Transform transform, const ExecutionPolicy& policy = seq) const {
+        check_positions(first, last);
+        if (first == last) {
+            return init;
+        }
+        size_t n = elements.size();
+        permutation_type sorted(elements.get_allocator());
+        const permutation_type* source = ordered_source(order, sorted, policy);
+        size_t chunks = detail::chunk_count(last - first, policy);
+        std::vector<std::optional<R>> partials(chunks);
+        detail::parallel_chunks(last - first, chunks, [&](size_t chunk, size_t begin, size_t end) {
+            size_t pos = first + begin;
+            R acc = transform(element_at(order, source, n, pos));
+            for (++pos; pos < first + end; ++pos) {
+                acc = reduce(std::move(acc), transform(element_at(order, source, n, pos)));
+            }
+            partials[chunk].emplace(std::move(acc));
+        });
+        for (auto& partial : partials) {
+            init = reduce(std::move(init), std::move(*partial));
+        }
+        return init;
+    }
+
     /**
      * @brief Output stream operator for printing the container
      * @param os The output stream
@@ -99,15 +3116,15 @@ public:
      * @brief Get iterator to beginning (default: insertion order)
      * @return Iterator pointing to the first element
      */
-    OrderIterator begin() { 
+    ARIEL_CONSTEXPR20 OrderIterator begin() { 
         return OrderIterator(*this); }
     
     /**
      * @brief Get iterator to end (default: insertion order)
      * @return Iterator pointing past the last element
      */
-    OrderIterator end() {
-        return OrderIterator(*this, true); }
+    ARIEL_CONSTEXPR20 OrderIterator end() {
+        return OrderIterator(*this, detail::end_tag); }
 
     // Specialized iterator methods
     
@@ -115,131 +3132,400 @@ public:
      * @brief Get iterator for ascending order traversal
      * @return Iterator to beginning of ascending sequence
      */
-    AscendingIterator begin_ascending_order() { 
+    ARIEL_CONSTEXPR20 AscendingIterator begin_ascending_order() { 
         return AscendingIterator(*this); }
     
     /**
      * @brief Get end iterator for ascending order traversal
      * @return Iterator to end of ascending sequence
      */
-    AscendingIterator end_ascending_order() { 
-        return AscendingIterator(*this, true); }
+    ARIEL_CONSTEXPR20 AscendingIterator end_ascending_order() { 
+        return AscendingIterator(*this, detail::end_tag); }
+
+    /**
+     * @brief Get iterator for ascending traversal by a per-call ordering
+     *
+     * Orders elements as std::ranges::sort(range, comp, proj) would, e.g.
+     * begin_ascending_order(std::less<>(), &Record::key). Pair it with
+     * end_ascending_order().
+     *
+     * @param comp Comparator applied to the projected values
+     * @param proj Projection applied to each element (default: identity)
+     * @return Iterator to beginning of the ascending sequence
+     */
+    template <typename Comp, typename Proj = detail::identity>
+    ARIEL_CONSTEXPR20 AscendingIterator begin_ascending_order(Comp comp, Proj proj = {}) {
+        return AscendingIterator(*this, detail::sort_with, detail::projected_less<Comp, Proj>{comp, proj}); }
 
     /**
      * @brief Get iterator for descending order traversal
      * @return Iterator to beginning of descending sequence
      */
-    DescendingIterator begin_descending_order() { 
+    ARIEL_CONSTEXPR20 DescendingIterator begin_descending_order() { 
         return DescendingIterator(*this); }
     
     /**
      * @brief Get end iterator for descending order traversal
      * @return Iterator to end of descending sequence
      */
-    DescendingIterator end_descending_order() { 
-        return DescendingIterator(*this, true); }
+    ARIEL_CONSTEXPR20 DescendingIterator end_descending_order() { 
+        return DescendingIterator(*this, detail::end_tag); }
+
+    /**
+     * @brief Get iterator for descending traversal by a per-call ordering
+     * @param comp Comparator applied to the projected values (visited in reverse)
+     * @param proj Projection applied to each element (default: identity)
+     * @return Iterator to beginning of the descending sequence
+     */
+    template <typename Comp, typename Proj = detail::identity>
+    ARIEL_CONSTEXPR20 DescendingIterator begin_descending_order(Comp comp, Proj proj = {}) {
+        return DescendingIterator(*this, detail::sort_with, detail::projected_less<Comp, Proj>{comp, proj}); }
 
     /**
      * @brief Get iterator for side cross order traversal
      * @return Iterator to beginning of side cross sequence
      */
-    SideCrossIterator begin_side_cross_order() { 
+    ARIEL_CONSTEXPR20 SideCrossIterator begin_side_cross_order() { 
         return SideCrossIterator(*this); }
     
     /**
      * @brief Get end iterator for side cross order traversal
      * @return Iterator to end of side cross sequence
      */
-    SideCrossIterator end_side_cross_order() { 
-        return SideCrossIterator(*this, true); }
+    ARIEL_CONSTEXPR20 SideCrossIterator end_side_cross_order() { 
+        return SideCrossIterator(*this, detail::end_tag); }
+
+    /**
+     * @brief Get iterator for side cross traversal by a per-call ordering
+     * @param comp Comparator applied to the projected values
+     * @param proj Projection applied to each element (default: identity)
+     * @return Iterator to beginning of the side cross sequence
+     */
+    template <typename Comp, typename Proj = detail::identity>
+    ARIEL_CONSTEXPR20 SideCrossIterator begin_side_cross_order(Comp comp, Proj proj = {}) {
+        return SideCrossIterator(*this, detail::sort_with, detail::projected_less<Comp, Proj>{comp, proj}); }
 
     /**
      * @brief Get iterator for reverse order traversal
      * @return Iterator to beginning of reverse sequence
      */
-    ReverseIterator begin_reverse_order() { 
+    ARIEL_CONSTEXPR20 ReverseIterator begin_reverse_order() { 
         return ReverseIterator(*this); }
     
     /**
      * @brief Get end iterator for reverse order traversal
      * @return Iterator to end of reverse sequence
      */
-    ReverseIterator end_reverse_order() { 
-        return ReverseIterator(*this, true); }
+    ARIEL_CONSTEXPR20 ReverseIterator end_reverse_order() { 
+        return ReverseIterator(*this, detail::end_tag); }
 
     /**
      * @brief Get iterator for normal order traversal (same as begin())
      * @return Iterator to beginning of normal sequence
      */
-    OrderIterator begin_order() { 
+    ARIEL_CONSTEXPR20 OrderIterator begin_order() { 
         return OrderIterator(*this); }
     
     /**
      * @brief Get end iterator for normal order traversal (same as end())
      * @return Iterator to end of normal sequence
      */
-    OrderIterator end_order() { 
-        return OrderIterator(*this, true); }
+    ARIEL_CONSTEXPR20 OrderIterator end_order() { 
+        return OrderIterator(*this, detail::end_tag); }
 
     /**
      * @brief Get iterator for middle-out order traversal
      * @return Iterator to beginning of middle-out sequence
      */
-    MiddleOutIterator begin_middle_out_order() { 
+    ARIEL_CONSTEXPR20 MiddleOutIterator begin_middle_out_order() { 
         return MiddleOutIterator(*this); }
     
     /**
      * @brief Get end iterator for middle-out order traversal
      * @return Iterator to end of middle-out sequence
      */
-    MiddleOutIterator end_middle_out_order() { 
-        return MiddleOutIterator(*this, true); }
+    ARIEL_CONSTEXPR20 MiddleOutIterator end_middle_out_order() { 
+        return MiddleOutIterator(*this, detail::end_tag); }
+
+    /**
+     * @brief Get iterator for a user-defined order
+     * @tparam Policy Ordering policy (see OrderPolicy)
+     * @return Iterator to beginning of the policy's sequence
+     */
+    template <typename Policy>
+    ARIEL_CONSTEXPR20 Iterator<Policy> begin_custom_order() {
+        return Iterator<Policy>(*this); }
+
+    /**
+     * @brief Get end iterator for a user-defined order
+     * @tparam Policy Ordering policy (see OrderPolicy)
+     * @return Iterator to end of the policy's sequence
+     */
+    template <typename Policy>
+    ARIEL_CONSTEXPR20 Iterator<Policy> end_custom_order() {
+        return Iterator<Policy>(*this, detail::end_tag); }
+
+    /**
+     * @brief Get the groups of equal elements in ascending order
+     *
+     * Each group is visited once as a (value, count) pair, where value is
+     * the group's first element in ascending order, so duplicates are
+     * counted rather than expanded. Elements are equal if neither compares
+     * less than the other.
+     *
+     * @return Range of GroupIterator over the groups
+     */
+    ARIEL_CONSTEXPR20 IteratorRange<GroupIterator> equal_ranges() {
+        return IteratorRange<GroupIterator>(GroupIterator(*this), GroupIterator(*this, detail::end_tag));
+    }
+
+    /**
+     * @brief Create a lazy, chunked producer for an iteration order
+     * @param order The iteration order
+     * @param chunk_size Number of elements produced per chunk
+     * @return Stream producing the elements chunk by chunk
+     */
+    OrderStream stream(Order order, size_t chunk_size = 1024) const {
+        return OrderStream(*this, order, chunk_size);
+    }
+
+    /**
+     * @brief Hand the elements of an iteration order to a callback, one chunk at a time
+     *
+     * Sorted orders only sort as much as the chunks produced so far require,
+     * so the first chunk is available long before a full sort would finish.
+     * The callback receives a pointer to the chunk and its length; if it
+     * returns bool, returning false stops the traversal.
+     *
+     * @param order The iteration order
+     * @param callback Callable taking (const T* data, size_t count)
+     * @param chunk_size Number of elements per chunk
+     */
+    template <typename Callback>
+    void for_each_chunk(Order order, Callback callback, size_t chunk_size = 1024) const {
+        OrderStream producer(*this, order, chunk_size);
+        while (producer.next()) {
+            const storage_type& chunk = producer.chunk();
+            if constexpr (std::is_same<decltype(callback(chunk.data(), chunk.size())), bool>::value) {
+                if (!callback(chunk.data(), chunk.size())) {
+                    return;
+                }
+            } else {
+                callback(chunk.data(), chunk.size());
+            }
+        }
+    }
+
+#ifdef ARIEL_HAS_COROUTINES
+    /**
+     * @brief Lazily generate the elements of an iteration order (C++20 only)
+     *
+     * The container must outlive the generator and must not be modified
+     * while it is being consumed.
+     *
+     * @param order The iteration order
+     * @param chunk_size Number of elements prepared per resumption batch
+     * @return Generator yielding the elements in iteration order
+     */
+    Generator<T> generate(Order order, size_t chunk_size = 1024) const {
+        OrderStream producer(*this, order, chunk_size);
+        while (producer.next()) {
+            for (const T& value : producer.chunk()) {
+                co_yield value;
+            }
+        }
+    }
+#endif
 
     /**
      * @brief Base iterator class for all iteration strategies
      * 
      * Provides common functionality for all iterator types.
-     * Stores a copy of elements in the desired order.
+     * Iterators read the container's elements in place. Sorted orders keep
+     * a permutation of element indices (4 bytes per element, whatever the
+     * size of T) that iterators created by the container borrow from its
+     * scratch pool and hand back when destroyed, so steady-state traversals
+     * do not allocate; insertion-based orders and end iterators need no
+     * permutation at all. Like std::vector iterators, iterators are
+     * invalidated by any mutation of the container.
      */
     class BaseIterator {
     protected:
-        std::vector<T> sorted_elements;  ///< Elements arranged in iteration order
-        size_t index;                    ///< Current position in iteration
+        detail::IntrusivePtr<ScratchPool> pool;  ///< Pool the permutation returns to (null if not pooled)
+        permutation_type order;             ///< Element indices in iteration order (sorted orders only)
+        const storage_type* elements;       ///< Storage the iterator reads from
+        size_t count;                       ///< Number of elements when the iterator was created
+        size_t index;                       ///< Current position in iteration
+
+    public:
+        // Iterator traits for STL compatibility
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        /**
+         * @brief Construct an iterator over an ordering of the container
+         *
+         * The order is a compile-time policy so that insertion-based orders
+         * do not require T to be comparable.
+         *
+         * @tparam Policy Ordering policy (see OrderPolicy)
+         * @param container The container to iterate over
+         * @param end If true, creates an end iterator (no permutation is built)
+         */
+        template <typename Policy>
+        ARIEL_CONSTEXPR20 BaseIterator(MyContainer& container, Policy, bool end)
+            : pool(Policy::sorted ? container.scratch_pool(end) : detail::IntrusivePtr<ScratchPool>()),
+              order(container.get_allocator()), elements(&container.elements),
+              count(container.elements.size()), index(end ? count : 0) {
+            if constexpr (Policy::sorted) {
+                if (end) {
+                    return;
+                }
+                if (pool) {
+                    order = pool->acquire();
+                }
+                const permutation_type& sorted = container.sorted_view();
+                if constexpr (detail::is_identity_policy<Policy>::value) {
+                    order = sorted;
+                } else {
+                    order.assign_mapped(sorted, Policy::index);
+                }
+            }
+        }
+
+        /**
+         * @brief Construct a singular iterator, not attached to a container
+         */
+        ARIEL_CONSTEXPR20 BaseIterator() : order(Allocator()), elements(nullptr), count(0), index(0) {}
+
+        /**
+         * @brief Construct an end iterator
+         *
+         * Unlike the constructors above this does not instantiate any
+         * sorting code, so end iterators of sorted orders also work for
+         * element types that are only ordered by a per-call comparator.
+         *
+         * @param container The container to iterate over
+         */
+        ARIEL_CONSTEXPR20 BaseIterator(const MyContainer& container, detail::end_tag_t)
+            : order(container.get_allocator()), elements(&container.elements),
+              count(container.elements.size()), index(count) {}
+
+        /**
+         * @brief Construct a begin iterator over a sorted order using a per-call comparator
+         *
+         * The ordering cache is bypassed since it holds the container's own order.
+         *
+         * @tparam Policy Ordering policy whose indices refer to the sorted elements
+         * @param container The container to iterate over
+         * @param less Strict weak ordering to sort by
+         */
+        template <typename Policy, typename Less>
+        ARIEL_CONSTEXPR20 BaseIterator(MyContainer& container, Policy, detail::sort_with_t, const Less& less)
+            : pool(container.scratch_pool(false)), order(container.get_allocator()),
+              elements(&container.elements), count(container.elements.size()), index(0) {
+            static_assert(Policy::sorted, "a comparator only applies to sorted orders");
+            permutation_type sorted(container.get_allocator());
+            if (pool) {
+                order = pool->acquire();
+                sorted = pool->acquire();
+            }
+            const storage_type& values = container.elements;
+            bool stable = container.stable;
+            sorted.assign_identity(count);
+            sorted.visit([&](auto& indices) {
+                std::sort(indices.begin(), indices.end(), [&](size_t a, size_t b) {
+                    if (less(values[a], values[b])) {
+                        return true;
+                    }
+                    return stable && a < b && !less(values[b], values[a]);
+                });
+            });
+            if constexpr (detail::is_identity_policy<Policy>::value) {
+                order.swap(sorted);
+            } else {
+                order.assign_mapped(sorted, Policy::index);
+            }
+            if (pool) {
+                pool->release(sorted);
+            }
+        }
 
-    public:
-        // Iterator traits for STL compatibility
-        using iterator_category = std::forward_iterator_tag;
-        using value_type = T;
-        using difference_type = std::ptrdiff_t;
-        using pointer = T*;
-        using reference = T&;
+        /**
+         * @brief Copy constructor - the copy borrows its permutation from the same pool
+         * @param other Iterator to copy
+         */
+        ARIEL_CONSTEXPR20 BaseIterator(const BaseIterator& other)
+            : pool(other.pool), order(other.order.get_allocator()), elements(other.elements),
+              count(other.count), index(other.index) {
+            if (pool) {
+                order = pool->acquire();
+            }
+            order = other.order;
+        }
+
+        BaseIterator(BaseIterator&&) = default;
 
         /**
-         * @brief Construct an iterator
-         * @param elems The elements to iterate over
-         * @param idx Starting index (0 for begin, size for end)
+         * @brief Copy assignment - copies into this iterator's own permutation
+         *
+         * The permutation keeps the allocator it was created with, so it
+         * also stays with the pool it will be returned to, even when other
+         * belongs to another container.
+         *
+         * @param other Iterator to copy
+         * @return Reference to this iterator
          */
-        BaseIterator(const std::vector<T>& elems, size_t idx = 0) 
-            : sorted_elements(elems), index(idx) {}
+        ARIEL_CONSTEXPR20 BaseIterator& operator=(const BaseIterator& other) {
+            order = other.order;
+            elements = other.elements;
+            count = other.count;
+            index = other.index;
+            return *this;
+        }
 
         /**
-         * @brief Dereference operator
-         * @return Reference to current element
+         * @brief Move assignment - takes over other's permutation and pool
+         *        when they share an allocator, and copies otherwise
+         * @param other Iterator to move from
+         * @return Reference to this iterator
          */
-        T& operator*() { return sorted_elements[index]; }
-        
+        ARIEL_CONSTEXPR20 BaseIterator& operator=(BaseIterator&& other) {
+            if (this == &other) {
+                return *this;
+            }
+            if (order.get_allocator() != other.order.get_allocator()) {
+                return *this = other;
+            }
+            if (pool) {
+                pool->release(order);
+            }
+            pool = std::move(other.pool);
+            order = std::move(other.order);
+            elements = other.elements;
+            count = other.count;
+            index = other.index;
+            return *this;
+        }
+
         /**
-         * @brief Arrow operator
-         * @return Pointer to current element
+         * @brief Destructor - returns the permutation to the scratch pool
          */
-        T* operator->() { return &sorted_elements[index]; }
+        ARIEL_CONSTEXPR20 ~BaseIterator() {
+            if (pool) {
+                pool->release(order);
+            }
+        }
 
         /**
          * @brief Equality comparison
          * @param other Iterator to compare with
          * @return true if iterators point to same position
          */
-        bool operator==(const BaseIterator& other) const {
+        constexpr bool operator==(const BaseIterator& other) const {
             return index == other.index;
         }
 
@@ -248,33 +3534,84 @@ public:
          * @param other Iterator to compare with
          * @return true if iterators point to different positions
          */
-        bool operator!=(const BaseIterator& other) const {
+        constexpr bool operator!=(const BaseIterator& other) const {
             return !(*this == other);
         }
     };
 
     /**
-     * @brief Iterator for ascending order traversal
-     * 
-     * Iterates through elements in sorted ascending order
+     * @brief Iterator over the order described by an ordering policy
+     *
+     * All built-in orders are instances of this template (AscendingIterator
+     * is Iterator<OrderPolicy<Order::Ascending>>, and so on); user-defined
+     * policies get the same code with the mapping inlined.
+     *
+     * @tparam Policy Ordering policy (see OrderPolicy)
      */
-    class AscendingIterator : public BaseIterator {
+    template <typename Policy>
+    class Iterator : public BaseIterator {
+    private:
+        /**
+         * @brief Index in the container of the element at the current position
+         * @return The element index
+         */
+        ARIEL_CONSTEXPR20 size_t element_index() const {
+            if constexpr (Policy::sorted) {
+                return this->order[this->index];
+            } else if constexpr (detail::is_identity_policy<Policy>::value) {
+                return this->index;
+            } else {
+                // The order is materialized only once an element was erased through the iterator
+                return this->order.empty() ? Policy::index(this->count, this->index) : this->order[this->index];
+            }
+        }
+
+        friend class MyContainer;
+
     public:
         /**
-         * @brief Construct ascending iterator
+         * @brief Construct an iterator
          * @param container The container to iterate over
          * @param end If true, creates an end iterator
          */
-        AscendingIterator(MyContainer& container, bool end = false) 
-            : BaseIterator(container.elements, end ? container.elements.size() : 0) {
-            std::sort(this->sorted_elements.begin(), this->sorted_elements.end());
-        }
+        ARIEL_CONSTEXPR20 Iterator(MyContainer& container, bool end = false)
+            : BaseIterator(container, Policy(), end) {}
+
+        /**
+         * @brief Construct a begin iterator sorting with a per-call comparator
+         * @param container The container to iterate over
+         * @param tag Selects this constructor
+         * @param less Strict weak ordering to sort by
+         */
+        template <typename Less>
+        ARIEL_CONSTEXPR20 Iterator(MyContainer& container, detail::sort_with_t tag, const Less& less)
+            : BaseIterator(container, Policy(), tag, less) {}
+
+        /**
+         * @brief Construct an end iterator
+         * @param container The container to iterate over
+         * @param tag Selects this constructor
+         */
+        ARIEL_CONSTEXPR20 Iterator(const MyContainer& container, detail::end_tag_t tag)
+            : BaseIterator(container, tag) {}
+
+        /**
+         * @brief Dereference operator
+         * @return Reference to the current element in the container
+         */
+        ARIEL_CONSTEXPR20 const T& operator*() const { return (*this->elements)[element_index()]; }
+
+        /**
+         * @brief Arrow operator
+         * @return Pointer to the current element in the container
+         */
+        ARIEL_CONSTEXPR20 const T* operator->() const { return &(*this->elements)[element_index()]; }
 
         /**
          * @brief Pre-increment operator
          * @return Reference to this iterator after increment
          */
-        AscendingIterator& operator++() {
+        ARIEL_CONSTEXPR20 Iterator& operator++() {
             ++this->index;
             return *this;
         }
@@ -283,36 +3620,91 @@ public:
          * @brief Post-increment operator
          * @return Copy of iterator before increment
          */
-        AscendingIterator operator++(int) {
-            AscendingIterator temp = *this;
+        ARIEL_CONSTEXPR20 Iterator operator++(int) {
+            Iterator temp = *this;
             ++(*this);
             return temp;
         }
     };
 
     /**
-     * @brief Iterator for descending order traversal
-     * 
-     * Iterates through elements in sorted descending order
+     * @brief Iterator over the groups of equal elements in ascending order
+     *
+     * Walks the ascending permutation and skips over each group of equal
+     * elements, dereferencing to the group's first element and its size.
      */
-    class DescendingIterator : public BaseIterator {
+    class GroupIterator : public BaseIterator {
+    private:
+        const Compare* compare;  ///< Comparator of the container
+        size_t group_end;        ///< Position after the current group
+
+        /**
+         * @brief Find the end of the group starting at the current position
+         */
+        ARIEL_CONSTEXPR20 void find_group_end() {
+            group_end = this->index;
+            if (group_end == this->count) {
+                return;
+            }
+            const T& first = (*this->elements)[this->order[group_end]];
+            ++group_end;
+            while (group_end < this->count && !(*compare)(first, (*this->elements)[this->order[group_end]])) {
+                ++group_end;
+            }
+        }
+
     public:
+        // A group refers to its first element in the container; value_type is
+        // the same pair so that the iterator models std::input_iterator
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<const T&, size_t>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = detail::ArrowProxy<value_type>;
+        using reference = value_type;
+
         /**
-         * @brief Construct descending iterator
+         * @brief Construct a singular iterator (only assignable and destructible)
+         */
+        ARIEL_CONSTEXPR20 GroupIterator() : BaseIterator(), compare(nullptr), group_end(0) {}
+
+        /**
+         * @brief Construct an iterator at the first group
          * @param container The container to iterate over
-         * @param end If true, creates an end iterator
          */
-        DescendingIterator(MyContainer& container, bool end = false)
-            : BaseIterator(container.elements, end ? container.elements.size() : 0) {
-            std::sort(this->sorted_elements.begin(), this->sorted_elements.end(), std::greater<T>());
+        ARIEL_CONSTEXPR20 explicit GroupIterator(MyContainer& container)
+            : BaseIterator(container, OrderPolicy<Order::Ascending>(), false), compare(&container.compare) {
+            find_group_end();
         }
 
         /**
-         * @brief Pre-increment operator
+         * @brief Construct an end iterator
+         * @param container The container to iterate over
+         * @param tag Selects this constructor
+         */
+        ARIEL_CONSTEXPR20 GroupIterator(const MyContainer& container, detail::end_tag_t tag)
+            : BaseIterator(container, tag), compare(&container.compare), group_end(this->count) {}
+
+        /**
+         * @brief Dereference operator
+         * @return The group's first element and the number of elements in the group
+         */
+        ARIEL_CONSTEXPR20 reference operator*() const {
+            return reference((*this->elements)[this->order[this->index]], group_end - this->index);
+        }
+
+        /**
+         * @brief Arrow operator
+         * @return Proxy giving access to the group's pair
+         */
+        ARIEL_CONSTEXPR20 pointer operator->() const { return pointer{**this}; }
+
+        /**
+         * @brief Pre-increment operator - moves to the next group
          * @return Reference to this iterator after increment
          */
-        DescendingIterator& operator++() {
-            ++this->index;
+        ARIEL_CONSTEXPR20 GroupIterator& operator++() {
+            this->index = group_end;
+            find_group_end();
             return *this;
         }
 
@@ -320,50 +3712,80 @@ public:
          * @brief Post-increment operator
          * @return Copy of iterator before increment
          */
-        DescendingIterator operator++(int) {
-            DescendingIterator temp = *this;
+        ARIEL_CONSTEXPR20 GroupIterator operator++(int) {
+            GroupIterator temp = *this;
             ++(*this);
             return temp;
         }
     };
 
     /**
-     * @brief Iterator for side cross order traversal
-     * 
-     * Iterates by alternating between smallest and largest remaining elements.
-     * Example: [1,2,3,4,5] -> [1,5,2,4,3]
+     * @brief Iterator over consecutive positions of the cached ascending
+     *        order, walked forwards or backwards (see ascending_range)
      */
-    class SideCrossIterator : public BaseIterator {
-    public:
+    class RangeIterator {
+    private:
+        const storage_type* elements = nullptr;    ///< Storage the iterator reads from
+        const permutation_type* sorted = nullptr;  ///< The container's ascending order
+        size_t remaining = 0;                      ///< Entries from the current one to the end of the
+                                                   ///< walk's direction; erasing behind stays valid
+        bool descending = false;                   ///< Whether the walk goes towards smaller positions
+
         /**
-         * @brief Construct side cross iterator
-         * @param container The container to iterate over
-         * @param end If true, creates an end iterator
+         * @brief Position of the current element in the ascending order
          */
-        SideCrossIterator(MyContainer& container, bool end = false)
-            : BaseIterator(std::vector<T>(), end ? container.elements.size() : 0) {
-            if (!container.elements.empty()) {
-                std::vector<T> temp = container.elements;
-                std::sort(temp.begin(), temp.end());
-                
-                this->sorted_elements.clear();
-                int left = 0, right = temp.size() - 1;
-                
-                while (left <= right) {
-                    this->sorted_elements.push_back(temp[left++]);
-                    if (left <= right) {
-                        this->sorted_elements.push_back(temp[right--]);
-                    }
-                }
-            }
+        ARIEL_CONSTEXPR20 size_t sorted_position() const {
+            return descending ? remaining - 1 : sorted->size() - remaining;
+        }
+
+        ARIEL_CONSTEXPR20 const T& current() const {
+            return (*elements)[(*sorted)[sorted_position()]];
         }
 
+        friend class MyContainer;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        /**
+         * @brief Construct a singular iterator (only assignable and destructible)
+         */
+        constexpr RangeIterator() = default;
+
+        /**
+         * @brief Construct an iterator
+         * @param elements The container's elements
+         * @param sorted The container's ascending order
+         * @param position Starting position (one past it when descending)
+         * @param descending Whether to walk towards smaller positions
+         */
+        ARIEL_CONSTEXPR20 RangeIterator(const storage_type& elements, const permutation_type& sorted,
+                                        size_t position, bool descending)
+            : elements(&elements), sorted(&sorted), remaining(descending ? position : sorted.size() - position),
+              descending(descending) {}
+
+        /**
+         * @brief Dereference operator
+         * @return Reference to the current element in the container
+         */
+        ARIEL_CONSTEXPR20 const T& operator*() const { return current(); }
+
+        /**
+         * @brief Arrow operator
+         * @return Pointer to the current element in the container
+         */
+        ARIEL_CONSTEXPR20 const T* operator->() const { return &current(); }
+
         /**
          * @brief Pre-increment operator
          * @return Reference to this iterator after increment
          */
-        SideCrossIterator& operator++() {
-            ++this->index;
+        ARIEL_CONSTEXPR20 RangeIterator& operator++() {
+            --remaining;
             return *this;
         }
 
@@ -371,143 +3793,459 @@ public:
          * @brief Post-increment operator
          * @return Copy of iterator before increment
          */
-        SideCrossIterator operator++(int) {
-            SideCrossIterator temp = *this;
+        ARIEL_CONSTEXPR20 RangeIterator operator++(int) {
+            RangeIterator temp = *this;
             ++(*this);
             return temp;
         }
+
+        /**
+         * @brief Equality comparison
+         * @param other Iterator to compare with
+         * @return true if iterators point to same position
+         */
+        constexpr bool operator==(const RangeIterator& other) const {
+            return remaining == other.remaining;
+        }
+
+        /**
+         * @brief Inequality comparison
+         * @param other Iterator to compare with
+         * @return true if iterators point to different positions
+         */
+        constexpr bool operator!=(const RangeIterator& other) const {
+            return !(*this == other);
+        }
     };
 
     /**
-     * @brief Iterator for reverse order traversal
-     * 
-     * Iterates through elements in reverse insertion order
+     * @brief Pull-based producer of an iteration order in chunks
+     *
+     * Insertion-based orders read the container directly. Sorted orders work
+     * on a private index permutation in which only the ranks needed so far
+     * are settled:
+     * the settled prefix and suffix grow geometrically via nth_element, so
+     * the first chunk costs O(n + k log k) while a full traversal stays
+     * O(n log n). The container must outlive the stream.
      */
-    class ReverseIterator : public BaseIterator {
+    class OrderStream {
+    private:
+        const MyContainer* container;  ///< Container being traversed
+        Order order;                   ///< Iteration order produced
+        size_t chunk_size;             ///< Maximum elements per chunk
+        size_t position;               ///< Number of elements produced so far
+        permutation_type work;         ///< Partially sorted indices (sorted orders only)
+        size_t low;                    ///< Ranks [0, low) of work are final
+        size_t high;                   ///< Ranks [high, n) of work are final
+        storage_type current;        ///< Elements of the current chunk
+
+        /**
+         * @brief Make sure ranks [0, low_end) and [high_begin, n) are final
+         * @param low_end Number of smallest ranks needed
+         * @param high_begin First of the largest ranks needed
+         */
+        void settle(size_t low_end, size_t high_begin) {
+            size_t n = work.size();
+            if (low >= high) {
+                return;  // every rank is already final
+            }
+            if (low_end > low) {
+                low_end = std::max(low_end, std::min(high, 2 * low));
+            }
+            if (high_begin < high) {
+                high_begin = std::min(high_begin, n - std::min(n - low, 2 * (n - high)));
+            }
+            const MyContainer& owner = *container;
+            auto less = [&owner](size_t a, size_t b) {
+                return owner.index_less(owner.elements, a, b);
+            };
+            work.visit([&](auto& indices) {
+                auto first = indices.begin();
+                if (low_end >= high_begin) {
+                    std::sort(first + low, first + high, less);
+                    low = high;
+                    return;
+                }
+                if (low_end > low) {
+                    std::nth_element(first + low, first + low_end, first + high, less);
+                    std::sort(first + low, first + low_end, less);
+                    low = low_end;
+                }
+                if (high_begin < high) {
+                    std::nth_element(first + low, first + high_begin, first + high, less);
+                    std::sort(first + high_begin, first + high, less);
+                    high = high_begin;
+                }
+            });
+        }
+
     public:
         /**
-         * @brief Construct reverse iterator
-         * @param container The container to iterate over
-         * @param end If true, creates an end iterator
+         * @brief Construct a stream positioned before the first chunk
+         * @param container The container to traverse
+         * @param order The iteration order
+         * @param chunk_size Maximum number of elements per chunk (at least 1)
          */
-        ReverseIterator(MyContainer& container, bool end = false)
-            : BaseIterator(container.elements, end ? container.elements.size() : 0) {
-            std::reverse(this->sorted_elements.begin(), this->sorted_elements.end());
+        OrderStream(const MyContainer& container, Order order, size_t chunk_size)
+            : container(&container), order(order), chunk_size(std::max<size_t>(1, chunk_size)),
+              position(0), work(container.get_allocator()), low(0), high(0),
+              current(container.get_allocator()) {
+            if (detail::is_sorted_order(order)) {
+                if (const permutation_type* cached = container.cached_sorted()) {
+                    work = *cached;  // already fully ordered: low == high
+                } else {
+                    work.assign_identity(container.elements.size());
+                    high = work.size();
+                }
+            }
         }
 
         /**
-         * @brief Pre-increment operator
-         * @return Reference to this iterator after increment
+         * @brief Produce the next chunk
+         * @return false once every element has been produced
          */
-        ReverseIterator& operator++() {
-            ++this->index;
-            return *this;
+        bool next() {
+            size_t n = container->elements.size();
+            current.clear();
+            if (position >= n) {
+                return false;
+            }
+            size_t end = std::min(n, position + chunk_size);
+            if (order == Order::Ascending) {
+                settle(end, n);
+            } else if (order == Order::Descending) {
+                settle(0, n - end);
+            } else if (order == Order::SideCross) {
+                settle((end + 1) / 2, n - end / 2);
+            }
+            const permutation_type* sorted = detail::is_sorted_order(order) ? &work : nullptr;
+            for (; position < end; ++position) {
+                current.push_back(container->element_at(order, sorted, n, position));
+            }
+            return true;
         }
 
         /**
-         * @brief Post-increment operator
-         * @return Copy of iterator before increment
+         * @brief Get the chunk produced by the last call to next()
+         * @return The elements of the current chunk, in iteration order
          */
-        ReverseIterator operator++(int) {
-            ReverseIterator temp = *this;
-            ++(*this);
-            return temp;
+        const storage_type& chunk() const {
+            return current;
         }
     };
 
+private:
     /**
-     * @brief Iterator for normal order traversal
-     * 
-     * Iterates through elements in insertion order
+     * @brief Get the index of the element an iterator points to
+     * @param it Iterator of any order of this container
+     * @return The element index
+     * @throws std::out_of_range if it is an end iterator or belongs to another container
+     */
+    template <typename Policy>
+    ARIEL_CONSTEXPR20 size_t index_of(const Iterator<Policy>& it) const {
+        if (it.elements != &elements || it.count != elements.size() || it.index >= it.count) {
+            throw std::out_of_range("Iterator does not point to an element of this container");
+        }
+        return it.element_index();
+    }
+
+    /**
+     * @brief Get the index of the element a range view iterator points to
+     * @param it Iterator of a range view of this container
+     * @return The element index
+     * @throws std::out_of_range if it is an end iterator or belongs to another container
+     */
+    ARIEL_CONSTEXPR20 size_t index_of(const RangeIterator& it) const {
+        size_t position = it.sorted_position();
+        if (it.elements != &elements || it.sorted != &sorted_order || !sorted_valid ||
+            position >= sorted_order.size()) {
+            throw std::out_of_range("Iterator does not point to an element of this container");
+        }
+        return sorted_order[position];
+    }
+
+    /**
+     * @brief Move an iterator past the element just erased through it
+     *
+     * Orders whose mapping depends on the element count (middle out,
+     * custom) are pinned to a permutation first, so that the rest of the
+     * walk is the one the iterator started.
+     *
+     * @param it The iterator, pointing to the erased element
+     * @param index Index the erased element had
+     */
+    template <typename Policy>
+    ARIEL_CONSTEXPR20 void skip_erased(Iterator<Policy>& it, size_t index) const {
+        if constexpr (!Policy::sorted && !detail::is_identity_policy<Policy>::value) {
+            if (it.order.empty()) {
+                size_t n = it.count;
+                it.order.assign_identity(n);
+                it.order.visit([&](auto& indices) {
+                    using index_type = typename std::decay_t<decltype(indices)>::value_type;
+                    for (size_t pos = 0; pos < n; ++pos) {
+                        indices[pos] = static_cast<index_type>(Policy::index(n, pos));
+                    }
+                });
+            }
+        }
+        if constexpr (Policy::sorted || !detail::is_identity_policy<Policy>::value) {
+            it.order.erase_index(index);
+        }
+        --it.count;
+    }
+
+    /**
+     * @brief Move a range view iterator past the element just erased through it
+     * @param it The iterator, pointing to the erased element
+     */
+    ARIEL_CONSTEXPR20 void skip_erased(RangeIterator& it, size_t) const {
+        --it.remaining;
+    }
+
+    /**
+     * @brief Position in the cached ascending order of the element an
+     *        iterator points to, if the iterator knows it
+     * @param it Iterator of any order of this container
+     * @return A candidate position (checked by sorted_position)
+     */
+    template <typename Policy>
+    ARIEL_CONSTEXPR20 size_t position_hint(const Iterator<Policy>& it) const {
+        if constexpr (Policy::sorted) {
+            return Policy::index(it.count, it.index);
+        } else {
+            return sorted_order.size();
+        }
+    }
+
+    /**
+     * @brief Position in the cached ascending order of the element a range
+     *        view iterator points to
+     * @param it Iterator of a range view of this container
+     * @return The position
+     */
+    ARIEL_CONSTEXPR20 size_t position_hint(const RangeIterator& it) const {
+        return it.sorted_position();
+    }
+
+    /**
+     * @brief Find the position of an element in the valid ascending order
+     *        (cache lock must be held)
+     * @param index The element index
+     * @param hint Candidate position, used if it holds index
+     * @return The position of index in sorted_order
+     */
+    ARIEL_CONSTEXPR20 size_t sorted_position(size_t index, size_t hint) const {
+        if (hint < sorted_order.size() && sorted_order[hint] == index) {
+            return hint;
+        }
+        // Entries ordered before the element; with stable ordering that is exactly its position,
+        // otherwise it is the first of its equal elements
+        size_t position = detail::partition_point(
+            sorted_order.size(), [&](size_t pos) { return index_less(elements, sorted_order[pos], index); });
+        while (sorted_order[position] != index) {
+            ++position;
+        }
+        return position;
+    }
+
+    /**
+     * @brief Free list of ordering permutations shared by a container's iterators
+     *
+     * Released permutations are cleared but keep their capacity, so an
+     * iterator that borrows one can be filled without allocating. Iterators
+     * may be destroyed on any thread, hence the mutex.
      */
-    class OrderIterator : public BaseIterator {
+    class ScratchPool {
+    private:
+        std::mutex mutex;                                           ///< Guards free_buffers
+        std::vector<permutation_type, rebind_alloc<permutation_type>> free_buffers;  ///< Idle buffers
+        allocator_type alloc;                                       ///< Allocator for new buffers
+        std::atomic<size_t> references{0};                          ///< IntrusivePtr count
+
+        using pool_traits = std::allocator_traits<rebind_alloc<ScratchPool>>;
+
     public:
+        /// Maximum number of idle buffers kept
+        static constexpr size_t max_buffers = 8;
+
         /**
-         * @brief Construct normal order iterator
-         * @param container The container to iterate over
-         * @param end If true, creates an end iterator
+         * @brief Construct an empty pool
+         * @param alloc Allocator for the buffers
          */
-        OrderIterator(MyContainer& container, bool end = false)
-            : BaseIterator(container.elements, end ? container.elements.size() : 0) {}
+        explicit ScratchPool(const allocator_type& alloc)
+            : free_buffers(rebind_alloc<permutation_type>(alloc)), alloc(alloc) {}
 
         /**
-         * @brief Pre-increment operator
-         * @return Reference to this iterator after increment
+         * @brief Allocate a pool with the container's allocator
+         * @param alloc Allocator for the pool and its buffers
+         * @return The only reference to the new pool
          */
-        OrderIterator& operator++() {
-            ++this->index;
-            return *this;
+        static detail::IntrusivePtr<ScratchPool> create(const allocator_type& alloc) {
+            rebind_alloc<ScratchPool> pool_alloc(alloc);
+            ScratchPool* pool = pool_traits::allocate(pool_alloc, 1);
+            ::new (static_cast<void*>(pool)) ScratchPool(alloc);
+            return detail::IntrusivePtr<ScratchPool>(pool);
         }
 
         /**
-         * @brief Post-increment operator
-         * @return Copy of iterator before increment
+         * @brief Add a reference (used by IntrusivePtr)
          */
-        OrderIterator operator++(int) {
-            OrderIterator temp = *this;
-            ++(*this);
-            return temp;
+        void retain() {
+            references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Drop a reference, destroying the pool with the last one
+         */
+        void release_ref() {
+            if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                rebind_alloc<ScratchPool> pool_alloc(alloc);
+                this->~ScratchPool();
+                pool_traits::deallocate(pool_alloc, this, 1);
+            }
+        }
+
+        /**
+         * @brief Borrow an empty permutation, reusing an idle one if possible
+         * @return An empty permutation
+         */
+        permutation_type acquire() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (free_buffers.empty()) {
+                return permutation_type(alloc);
+            }
+            permutation_type buffer = std::move(free_buffers.back());
+            free_buffers.pop_back();
+            return buffer;
+        }
+
+        /**
+         * @brief Hand a permutation back; permutations without capacity are dropped
+         * @param buffer The permutation to recycle (left empty)
+         */
+        void release(permutation_type& buffer) {
+            if (!detail::owns_heap_buffer(buffer)) {
+                return;
+            }
+            buffer.clear();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (free_buffers.size() < max_buffers) {
+                free_buffers.push_back(std::move(buffer));
+            }
         }
     };
 
     /**
-     * @brief Iterator for middle-out order traversal
-     * 
-     * Iterates starting from the middle element, alternating outward.
-     * Example: [1,2,3,4,5] -> [3,2,4,1,5]
+     * @brief Worker thread rebuilding the ordering cache after quiet periods
      */
-    class MiddleOutIterator : public BaseIterator {
+    class Presorter {
     public:
+        std::mutex mutex;                    ///< Guards the owner's elements and cache
+        std::condition_variable wake;        ///< Signals mutations and shutdown
+        std::chrono::milliseconds quiet_period;  ///< Delay after the last mutation
+        std::chrono::steady_clock::time_point last_mutation;  ///< Time of the last mutation
+        bool pending = false;                ///< A mutation happened since the last rebuild
+        bool stopping = false;               ///< Set when the worker should exit
+        std::thread worker;                  ///< The background thread
+
         /**
-         * @brief Construct middle-out iterator
-         * @param container The container to iterate over
-         * @param end If true, creates an end iterator
+         * @brief Construct an idle presorter
+         * @param quiet Time without mutations before rebuilding
          */
-        MiddleOutIterator(MyContainer& container, bool end = false)
-            : BaseIterator(std::vector<T>(), end ? container.elements.size() : 0) {
-            if (!container.elements.empty()) {
-                std::vector<T> temp = container.elements;
-                this->sorted_elements.clear();
-                
-                int n = temp.size();
-                int middle = n / 2;
-                this->sorted_elements.push_back(temp[middle]);
-                
-                int left = middle - 1;
-                int right = middle + 1;
-                
-                while (left >= 0 || right < n) {
-                    if (left >= 0) {
-                        this->sorted_elements.push_back(temp[left--]);
-                    }
-                    if (right < n) {
-                        this->sorted_elements.push_back(temp[right++]);
-                    }
-                }
+        explicit Presorter(std::chrono::milliseconds quiet) : quiet_period(quiet) {}
+
+        /**
+         * @brief Stop and join the worker
+         */
+        ~Presorter() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            if (worker.joinable()) {
+                worker.join();
             }
         }
 
         /**
-         * @brief Pre-increment operator
-         * @return Reference to this iterator after increment
+         * @brief Record a mutation (mutex must be held)
          */
-        MiddleOutIterator& operator++() {
-            ++this->index;
-            return *this;
+        void touch() {
+            pending = true;
+            last_mutation = std::chrono::steady_clock::now();
+            wake.notify_one();
         }
 
         /**
-         * @brief Post-increment operator
-         * @return Copy of iterator before increment
+         * @brief Worker loop: wait for a quiet period, then sort a snapshot
+         *        outside the lock and publish it if nothing changed meanwhile
+         * @param owner The container whose cache is maintained
          */
-        MiddleOutIterator operator++(int) {
-            MiddleOutIterator temp = *this;
-            ++(*this);
-            return temp;
+        void run(MyContainer* owner) {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping) {
+                if (!pending) {
+                    wake.wait(lock);
+                    continue;
+                }
+                auto deadline = last_mutation + quiet_period;
+                if (std::chrono::steady_clock::now() < deadline) {
+                    wake.wait_until(lock, deadline);
+                    continue;
+                }
+                pending = false;
+                if (owner->sorted_valid) {
+                    continue;
+                }
+                storage_type snapshot(owner->elements, owner->elements.get_allocator());
+                size_t generation = owner->generation;
+                permutation_type order(snapshot.get_allocator());
+                bool ascending = owner->in_order;
+                bool prefix = owner->prefix_valid;
+                if (prefix && !ascending) {
+                    order = owner->sorted_order;
+                    if (!owner->tombstones.empty()) {
+                        order.drop_removed(owner->tombstones);
+                    }
+                }
+                lock.unlock();
+                owner->complete_order(order, snapshot, ascending, prefix, seq);
+                lock.lock();
+                if (!owner->sorted_valid && owner->generation == generation) {
+                    owner->sorted_order.swap(order);
+                    owner->tombstones.clear();  // dropped from the published order above
+                    owner->sorted_valid = owner->prefix_valid = true;
+                    owner->in_order = owner->in_order || owner->sorted_order.is_identity();
+                }
+            }
         }
     };
 };
 
+namespace pmr {
+
+/**
+ * @brief MyContainer whose elements and ordering buffers are allocated from
+ *        a std::pmr::memory_resource (e.g. a monotonic arena or a NUMA-local pool)
+ *
+ * With background sorting enabled the worker allocates its snapshot from
+ * the same resource, so the resource must then be thread-safe.
+ */
+template <typename T = int>
+using MyContainer = ariel::MyContainer<T, std::pmr::polymorphic_allocator<T>>;
+
+} // namespace pmr
+
+/**
+ * @brief MyContainer keeping up to N elements, and their orderings, in-object
+ *
+ * Containers that stay at or below N elements never touch the heap, neither
+ * for their storage nor for traversals; larger ones fall back to the heap.
+ */
+template <typename T, size_t N = 16>
+using SmallMyContainer = MyContainer<T, std::allocator<T>, N>;
+
 } // namespace ariel
 
 #endif // MYCONTAINER_HPP
\ No newline at end of file
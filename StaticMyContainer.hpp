@@ -0,0 +1,253 @@
+// Email: sone0149@gmail.com
+
+
+#ifndef STATICMYCONTAINER_HPP
+#define STATICMYCONTAINER_HPP
+
+#include "MyContainer.hpp"
+
+#include <array>
+
+namespace ariel {
+
+/**
+ * @brief A fixed-capacity, allocation-free variant of MyContainer
+ *
+ * Elements are stored in a std::array of N elements and sorted orderings
+ * are computed as an array of indices inside the iterator itself, so no
+ * operation ever touches the heap. Supports the same add/remove/size operations and the
+ * same six iteration orders as MyContainer. In C++20 builds every operation
+ * is constexpr, so a container (and its orderings) can be built at compile
+ * time and stored in a constexpr variable.
+ *
+ * @tparam T The type of elements stored (must be default constructible)
+ * @tparam N The maximum number of elements
+ */
+template <typename T, size_t N>
+class StaticMyContainer {
+private:
+    std::array<T, N> elements{};  ///< Element storage; only the first count are in use
+    size_t count = 0;             ///< Number of elements in the container
+
+    /// Element index type of the iterators' orderings (32 bits when N allows, as in detail::Permutation)
+    using index_type = std::conditional_t<(N <= std::numeric_limits<uint32_t>::max()), uint32_t, size_t>;
+
+public:
+    template <typename Policy>
+    class Iterator;
+
+    using AscendingIterator = Iterator<OrderPolicy<Order::Ascending>>;
+    using DescendingIterator = Iterator<OrderPolicy<Order::Descending>>;
+    using SideCrossIterator = Iterator<OrderPolicy<Order::SideCross>>;
+    using ReverseIterator = Iterator<OrderPolicy<Order::Reverse>>;
+    using OrderIterator = Iterator<OrderPolicy<Order::Normal>>;
+    using MiddleOutIterator = Iterator<OrderPolicy<Order::MiddleOut>>;
+
+    /**
+     * @brief Default constructor - creates an empty container
+     */
+    StaticMyContainer() = default;
+
+    /**
+     * @brief Add an element to the container
+     * @param element The element to add
+     * @throws std::runtime_error if the container is full
+     */
+    ARIEL_CONSTEXPR20 void add(const T& element) {
+        if (count == N) {
+            throw std::runtime_error("Container capacity exceeded");
+        }
+        elements[count++] = element;
+    }
+
+    /**
+     * @brief Remove all instances of an element from the container
+     * @param element The element to remove
+     * @throws std::runtime_error if the element is not found
+     */
+    ARIEL_CONSTEXPR20 void remove(const T& element) {
+        size_t initial_size = count;
+        count = static_cast<size_t>(
+            std::remove(elements.begin(), elements.begin() + count, element) - elements.begin());
+
+        if (count == initial_size) {
+            throw std::runtime_error("Element not found in container");
+        }
+    }
+
+    /**
+     * @brief Get the number of elements in the container
+     * @return The size of the container
+     */
+    constexpr size_t size() const {
+        return count;
+    }
+
+    /**
+     * @brief Get the maximum number of elements
+     * @return The compile-time capacity N
+     */
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+    /**
+     * @brief Output stream operator for printing the container
+     * @param os The output stream
+     * @param container The container to print
+     * @return The output stream
+     */
+    friend std::ostream& operator<<(std::ostream& os, const StaticMyContainer& container) {
+        os << "[";
+        for (size_t i = 0; i < container.count; ++i) {
+            os << container.elements[i];
+            if (i < container.count - 1) {
+                os << ", ";
+            }
+        }
+        os << "]";
+        return os;
+    }
+
+    ARIEL_CONSTEXPR20 OrderIterator begin() const { return OrderIterator(*this); }
+    ARIEL_CONSTEXPR20 OrderIterator end() const { return OrderIterator(*this, true); }
+
+    ARIEL_CONSTEXPR20 AscendingIterator begin_ascending_order() const { return AscendingIterator(*this); }
+    ARIEL_CONSTEXPR20 AscendingIterator end_ascending_order() const { return AscendingIterator(*this, true); }
+
+    ARIEL_CONSTEXPR20 DescendingIterator begin_descending_order() const { return DescendingIterator(*this); }
+    ARIEL_CONSTEXPR20 DescendingIterator end_descending_order() const { return DescendingIterator(*this, true); }
+
+    ARIEL_CONSTEXPR20 SideCrossIterator begin_side_cross_order() const { return SideCrossIterator(*this); }
+    ARIEL_CONSTEXPR20 SideCrossIterator end_side_cross_order() const { return SideCrossIterator(*this, true); }
+
+    ARIEL_CONSTEXPR20 ReverseIterator begin_reverse_order() const { return ReverseIterator(*this); }
+    ARIEL_CONSTEXPR20 ReverseIterator end_reverse_order() const { return ReverseIterator(*this, true); }
+
+    ARIEL_CONSTEXPR20 OrderIterator begin_order() const { return OrderIterator(*this); }
+    ARIEL_CONSTEXPR20 OrderIterator end_order() const { return OrderIterator(*this, true); }
+
+    ARIEL_CONSTEXPR20 MiddleOutIterator begin_middle_out_order() const { return MiddleOutIterator(*this); }
+    ARIEL_CONSTEXPR20 MiddleOutIterator end_middle_out_order() const { return MiddleOutIterator(*this, true); }
+
+    template <typename Policy>
+    ARIEL_CONSTEXPR20 Iterator<Policy> begin_custom_order() const { return Iterator<Policy>(*this); }
+    template <typename Policy>
+    ARIEL_CONSTEXPR20 Iterator<Policy> end_custom_order() const { return Iterator<Policy>(*this, true); }
+
+    /**
+     * @brief Iterator reading the container's elements through the ordering policy
+     *
+     * Sorted policies sort an in-object array of element indices once on
+     * construction (not at all for end iterators); insertion-based policies
+     * need no array at all. Elements are read from the container, using the
+     * same ordering policies as MyContainer.
+     *
+     * @tparam Policy Ordering policy (see OrderPolicy)
+     */
+    template <typename Policy>
+    class Iterator {
+    private:
+        const StaticMyContainer* container = nullptr;              ///< Container being traversed
+        std::array<index_type, Policy::sorted ? N : 0> ordered{};  ///< Element indices in ascending order
+        size_t count = 0;                                          ///< Number of elements
+        size_t index = 0;                                          ///< Current position in iteration
+
+        /**
+         * @brief Get the index of the current element in the container
+         */
+        constexpr size_t source() const {
+            size_t position = Policy::index(count, index);
+            if constexpr (Policy::sorted) {
+                return ordered[position];
+            } else {
+                return position;
+            }
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        /**
+         * @brief Default constructor - creates a singular iterator
+         */
+        constexpr Iterator() = default;
+
+        /**
+         * @brief Construct an iterator
+         * @param container The container to iterate over
+         * @param end If true, creates an end iterator
+         */
+        ARIEL_CONSTEXPR20 Iterator(const StaticMyContainer& container, bool end = false)
+            : container(&container), count(container.count), index(end ? container.count : 0) {
+            if constexpr (Policy::sorted) {
+                if (end) {
+                    return;
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    ordered[i] = static_cast<index_type>(i);
+                }
+                std::sort(ordered.begin(), ordered.begin() + count, [&container](size_t a, size_t b) {
+                    return container.elements[a] < container.elements[b];
+                });
+            }
+        }
+
+        /**
+         * @brief Dereference operator
+         * @return Reference to current element
+         */
+        constexpr const T& operator*() const { return container->elements[source()]; }
+
+        /**
+         * @brief Arrow operator
+         * @return Pointer to current element
+         */
+        constexpr const T* operator->() const { return &container->elements[source()]; }
+
+        /**
+         * @brief Pre-increment operator
+         * @return Reference to this iterator after increment
+         */
+        constexpr Iterator& operator++() {
+            ++index;
+            return *this;
+        }
+
+        /**
+         * @brief Post-increment operator
+         * @return Copy of iterator before increment
+         */
+        constexpr Iterator operator++(int) {
+            Iterator temp = *this;
+            ++(*this);
+            return temp;
+        }
+
+        /**
+         * @brief Equality comparison
+         * @param other Iterator to compare with
+         * @return true if iterators point to same position
+         */
+        constexpr bool operator==(const Iterator& other) const {
+            return index == other.index;
+        }
+
+        /**
+         * @brief Inequality comparison
+         * @param other Iterator to compare with
+         * @return true if iterators point to different positions
+         */
+        constexpr bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+    };
+};
+
+} // namespace ariel
+
+#endif // STATICMYCONTAINER_HPP
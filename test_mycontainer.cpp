@@ -3,9 +3,17 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 #include "MyContainer.hpp"
+#include "StaticMyContainer.hpp"
+#include "CompactMyContainer.hpp"
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory_resource>
+#include <sstream>
+#include <array>
 
 using namespace ariel;
 
@@ -312,8 +320,9 @@ TEST_CASE("Iterator edge cases") {
         container.add(42);
         auto it = container.begin_order();
         CHECK(*it == 42);
-        *it = 43;  // Should be able to modify through iterator
-        CHECK(*it == 43);
+        // Iterators are read-only views of the stored elements
+        CHECK(std::is_same_v<decltype(*it), const int&>);
+        CHECK(&*it == &*container.begin_reverse_order());
     }
 
     SUBCASE("Arrow operator") {
@@ -395,4 +404,2057 @@ TEST_CASE("Complex scenarios") {
         CHECK(alphabetical[0] == "apple");
         CHECK(alphabetical[3] == "zebra");
     }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Materializing orders into a buffer") {
+    MyContainer<int> container;
+    container.add(7);
+    container.add(15);
+    container.add(6);
+    container.add(1);
+    container.add(2);
+
+    SUBCASE("Sequential materialization matches the iterators") {
+        std::vector<int> out(container.size());
+        container.materialize(Order::Ascending, out.begin());
+        CHECK(out == std::vector<int>{1, 2, 6, 7, 15});
+        container.materialize(Order::Descending, out.begin());
+        CHECK(out == std::vector<int>{15, 7, 6, 2, 1});
+        container.materialize(Order::SideCross, out.begin());
+        CHECK(out == std::vector<int>{1, 15, 2, 7, 6});
+        container.materialize(Order::Reverse, out.begin());
+        CHECK(out == std::vector<int>{2, 1, 6, 15, 7});
+        container.materialize(Order::Normal, out.begin());
+        CHECK(out == std::vector<int>{7, 15, 6, 1, 2});
+        container.materialize(Order::MiddleOut, out.begin());
+        CHECK(out == std::vector<int>{6, 15, 1, 7, 2});
+    }
+
+    SUBCASE("Parallel materialization matches sequential") {
+        const ExecutionPolicy four_threads{4, 1};
+        MyContainer<int> large;
+        for (int i = 0; i < 1001; ++i) {
+            large.add((i * 7919) % 1009);
+        }
+        for (Order order : {Order::Normal, Order::Ascending, Order::Descending,
+                            Order::SideCross, Order::Reverse, Order::MiddleOut}) {
+            std::vector<int> expected(large.size());
+            std::vector<int> actual(large.size());
+            large.materialize(order, expected.begin());
+            large.materialize(order, actual.begin(), four_threads);
+            CHECK(actual == expected);
+        }
+    }
+
+    SUBCASE("Even sized middle out starts at the upper middle") {
+        MyContainer<int> even;
+        even.add(1);
+        even.add(2);
+        even.add(3);
+        even.add(4);
+        int out[4];
+        even.materialize(Order::MiddleOut, out, par);
+        CHECK(out[0] == 3);
+        CHECK(out[1] == 2);
+        CHECK(out[2] == 4);
+        CHECK(out[3] == 1);
+    }
+
+    SUBCASE("Empty container writes nothing") {
+        MyContainer<int> empty;
+        std::vector<int> out;
+        empty.materialize(Order::SideCross, out.begin(), par);
+        CHECK(out.empty());
+    }
+}
+
+TEST_CASE("Parallel remove and remove_if") {
+    const ExecutionPolicy four_threads{4, 1};
+
+    SUBCASE("remove_if returns the number of removed elements") {
+        MyContainer<int> container;
+        for (int i = 0; i < 10; ++i) {
+            container.add(i);
+        }
+        CHECK(container.remove_if([](int x) { return x % 2 == 0; }) == 5);
+        CHECK(container.size() == 5);
+        CHECK(container.remove_if([](int x) { return x > 100; }) == 0);
+        CHECK(container.size() == 5);
+    }
+
+    SUBCASE("Parallel remove_if preserves insertion order") {
+        MyContainer<int> container;
+        std::vector<int> expected;
+        for (int i = 0; i < 1000; ++i) {
+            int value = (i * 37) % 101;
+            container.add(value);
+            if (value % 3 != 0) {
+                expected.push_back(value);
+            }
+        }
+        size_t removed = container.remove_if([](int x) { return x % 3 == 0; }, four_threads);
+        CHECK(removed == 1000 - expected.size());
+        std::vector<int> actual;
+        for (auto it = container.begin_order(); it != container.end_order(); ++it) {
+            actual.push_back(*it);
+        }
+        CHECK(actual == expected);
+    }
+
+    SUBCASE("Parallel remove of a single value") {
+        MyContainer<int> container;
+        for (int i = 0; i < 100; ++i) {
+            container.add(i % 4);
+        }
+        container.remove(2, four_threads);
+        CHECK(container.size() == 75);
+        CHECK_THROWS_AS(container.remove(2, four_threads), std::runtime_error);
+    }
+
+    SUBCASE("Parallel remove of non default constructible elements") {
+        struct Item {
+            int value;
+            explicit Item(int v) : value(v) {}
+            bool operator==(const Item& other) const { return value == other.value; }
+        };
+        MyContainer<Item> container;
+        for (int i = 0; i < 50; ++i) {
+            container.add(Item(i % 5));
+        }
+        CHECK(container.remove_if([](const Item& item) { return item.value < 2; }, four_threads) == 20);
+        int previous = -1;
+        bool cyclic = true;
+        for (auto it = container.begin_order(); it != container.end_order(); ++it) {
+            cyclic = cyclic && (previous == -1 || it->value == (previous == 4 ? 2 : previous + 1));
+            previous = it->value;
+        }
+        CHECK(container.size() == 30);
+        CHECK(cyclic);
+    }
+}
+
+TEST_CASE("for_each and transform_reduce over iteration orders") {
+    const ExecutionPolicy four_threads{4, 1};
+    MyContainer<int> container;
+    container.add(7);
+    container.add(15);
+    container.add(6);
+    container.add(1);
+    container.add(2);
+
+    SUBCASE("for_each visits elements in iteration order") {
+        std::vector<int> visited;
+        container.for_each(Order::SideCross, [&](int x) { visited.push_back(x); });
+        CHECK(visited == std::vector<int>{1, 15, 2, 7, 6});
+        visited.clear();
+        container.for_each(Order::MiddleOut, 1, 3, [&](int x) { visited.push_back(x); });
+        CHECK(visited == std::vector<int>{15, 1});
+    }
+
+    SUBCASE("Sum of the top half in ascending order") {
+        size_t half = container.size() / 2;
+        int sum = container.transform_reduce(Order::Ascending, half, container.size(), 0,
+                                             std::plus<int>(), [](int x) { return x; }, four_threads);
+        CHECK(sum == 6 + 7 + 15);
+    }
+
+    SUBCASE("Reduction combines chunks in order") {
+        MyContainer<int> digits;
+        for (int i = 0; i < 9; ++i) {
+            digits.add(i + 1);
+        }
+        std::string joined = digits.transform_reduce(
+            Order::Reverse, std::string(), std::plus<std::string>(),
+            [](int x) { return std::to_string(x); }, four_threads);
+        CHECK(joined == "987654321");
+    }
+
+    SUBCASE("Parallel for_each matches sequential totals") {
+        MyContainer<int> large;
+        for (int i = 0; i < 5000; ++i) {
+            large.add(i % 97);
+        }
+        std::atomic<long> total{0};
+        large.for_each(Order::Descending, [&](int x) { total += x; }, four_threads);
+        long expected = large.transform_reduce(Order::Normal, 0L, std::plus<long>(),
+                                               [](int x) { return long(x); });
+        CHECK(total.load() == expected);
+    }
+
+    SUBCASE("Invalid position range throws") {
+        CHECK_THROWS_AS(container.for_each(Order::Normal, 3, 2, [](int) {}), std::out_of_range);
+        CHECK_THROWS_AS(container.transform_reduce(Order::Normal, 0, 6, 0, std::plus<int>(),
+                                                   [](int x) { return x; }),
+                        std::out_of_range);
+    }
+}
+
+TEST_CASE("Lazy chunked streams for iteration orders") {
+    MyContainer<int> container;
+    for (int i = 0; i < 100; ++i) {
+        container.add((i * 37) % 101);
+    }
+    const Order orders[] = {Order::Normal, Order::Ascending, Order::Descending,
+                            Order::SideCross, Order::Reverse, Order::MiddleOut};
+
+    SUBCASE("Streams in chunks produce the same sequence as materialize") {
+        for (Order order : orders) {
+            std::vector<int> expected(container.size());
+            container.materialize(order, expected.begin());
+            for (size_t chunk_size : {1, 3, 7, 64, 1000}) {
+                std::vector<int> actual;
+                auto producer = container.stream(order, chunk_size);
+                while (producer.next()) {
+                    CHECK(producer.chunk().size() <= chunk_size);
+                    actual.insert(actual.end(), producer.chunk().begin(), producer.chunk().end());
+                }
+                CHECK(actual == expected);
+            }
+        }
+    }
+
+    SUBCASE("for_each_chunk stops when the callback returns false") {
+        std::vector<int> first_chunk;
+        size_t calls = 0;
+        container.for_each_chunk(Order::Ascending, [&](const int* data, size_t count) {
+            ++calls;
+            first_chunk.assign(data, data + count);
+            return false;
+        }, 10);
+        CHECK(calls == 1);
+        CHECK(first_chunk == std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+    }
+
+    SUBCASE("for_each_chunk with a void callback visits everything") {
+        size_t total = 0;
+        container.for_each_chunk(Order::SideCross, [&](const int*, size_t count) { total += count; }, 8);
+        CHECK(total == container.size());
+    }
+
+    SUBCASE("Empty container produces no chunks") {
+        MyContainer<int> empty;
+        auto producer = empty.stream(Order::Descending);
+        CHECK_FALSE(producer.next());
+    }
+
+#ifdef ARIEL_HAS_COROUTINES
+    SUBCASE("Coroutine generators yield every order lazily") {
+        for (Order order : orders) {
+            std::vector<int> expected(container.size());
+            container.materialize(order, expected.begin());
+            std::vector<int> actual;
+            for (int value : container.generate(order, 16)) {
+                actual.push_back(value);
+            }
+            CHECK(actual == expected);
+        }
+        auto gen = container.generate(Order::Descending, 4);
+        auto it = gen.begin();
+        CHECK(*it == 100);
+        ++it;
+        CHECK(*it == 99);
+    }
+#endif
+}
+
+namespace {
+
+/// Orders integers like std::less, counting the comparisons made
+struct CountingLess {
+    size_t* comparisons;
+    bool operator()(int a, int b) const {
+        ++*comparisons;
+        return a < b;
+    }
+};
+
+using CountedContainer = MyContainer<int, std::allocator<int>, 0, CountingLess>;
+
+} // namespace
+
+TEST_CASE("Ordering cache and background sorting") {
+    auto wait_until_cached = [](const MyContainer<int>& container) {
+        for (int attempt = 0; attempt < 400 && !container.orders_cached(); ++attempt) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return container.orders_cached();
+    };
+
+    SUBCASE("Sorted traversals fill the cache and mutations invalidate it") {
+        MyContainer<int> container;
+        container.add(3);
+        container.add(1);
+        CHECK_FALSE(container.orders_cached());
+        container.begin_ascending_order();
+        CHECK(container.orders_cached());
+        container.add(2);
+        CHECK_FALSE(container.orders_cached());
+        std::vector<int> descending;
+        for (auto it = container.begin_descending_order(); it != container.end_descending_order(); ++it) {
+            descending.push_back(*it);
+        }
+        CHECK(descending == std::vector<int>{3, 2, 1});
+        container.remove(3);
+        CHECK_FALSE(container.orders_cached());
+    }
+
+    SUBCASE("Appends at or above the maximum keep the cache warm") {
+        MyContainer<int> container;
+        for (int value : {5, 1, 3}) {
+            container.add(value);
+        }
+        container.begin_ascending_order();
+        for (int value : {5, 7, 7, 10}) {
+            container.add(value);
+            CHECK(container.orders_cached());
+        }
+        std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == std::vector<int>{1, 3, 5, 5, 7, 7, 10});
+    }
+
+    SUBCASE("Out-of-order appends are merged into the cached order") {
+        size_t comparisons = 0;
+        CountedContainer container(CountingLess{&comparisons});
+        for (int i = 0; i < 1000; ++i) {
+            container.add((i * 37) % 1000);
+        }
+        container.begin_ascending_order();
+        for (int value : {500, -3, 2000, 250}) {
+            container.add(value);
+            CHECK_FALSE(container.orders_cached());
+        }
+        std::vector<int> expected;
+        for (int i = 0; i < 1000; ++i) {
+            expected.push_back(i);
+        }
+        expected.insert(expected.end(), {500, -3, 2000, 250});
+        std::sort(expected.begin(), expected.end());
+
+        // Merging 4 pending elements takes O(n + k log k) comparisons, a full sort about n log2 n
+        const CountedContainer& view = container;
+        std::vector<int> materialized(expected.size());
+        comparisons = 0;
+        view.materialize(Order::Ascending, materialized.begin());
+        CHECK(materialized == expected);
+        CHECK(comparisons < 2 * expected.size());
+        CHECK_FALSE(container.orders_cached());
+
+        std::vector<int> descending(container.begin_descending_order(), container.end_descending_order());
+        CHECK(std::equal(descending.begin(), descending.end(), expected.rbegin()));
+        CHECK(container.orders_cached());
+
+        CountedContainer copy(container);
+        copy.add(1);
+        std::vector<int> copied(copy.begin_ascending_order(), copy.end_ascending_order());
+        expected.insert(std::upper_bound(expected.begin(), expected.end(), 1), 1);
+        CHECK(copied == expected);
+    }
+
+    SUBCASE("In-order and nearly in-order ingest never sorts from scratch") {
+        size_t comparisons = 0;
+        CountedContainer container(CountingLess{&comparisons});
+        const int n = 20000;
+        for (int i = 0; i < n; ++i) {
+            container.add(i);
+        }
+        std::vector<int> materialized(n + 2);
+        comparisons = 0;
+        container.materialize(Order::Ascending, materialized.begin());
+        CHECK(comparisons == 0);
+        CHECK(std::is_sorted(materialized.begin(), materialized.begin() + n));
+
+        container.begin_ascending_order();
+        container.add(5);
+        container.add(-1);
+        comparisons = 0;
+        container.materialize(Order::Ascending, materialized.begin());
+        CHECK(comparisons < 2 * static_cast<size_t>(n));
+        CHECK(materialized[0] == -1);
+        CHECK(std::is_sorted(materialized.begin(), materialized.end()));
+    }
+
+    SUBCASE("Removals are dropped from the cached order at the next merge") {
+        auto check_ascending = [](MyContainer<int>& container) {
+            std::vector<int> expected(container.begin(), container.end());
+            std::sort(expected.begin(), expected.end());
+            const MyContainer<int>& view = container;
+            std::vector<int> materialized(expected.size());
+            view.materialize(Order::Ascending, materialized.begin());
+            CHECK(materialized == expected);
+            std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+            CHECK(ascending == expected);
+        };
+        for (ExecutionPolicy policy : {seq, ExecutionPolicy{4, 16}}) {
+            MyContainer<int> container;
+            for (int i = 0; i < 500; ++i) {
+                container.add((i * 101) % 500);
+            }
+            container.begin_ascending_order();
+            container.remove_if([](int x) { return x % 7 == 0; }, policy);
+            CHECK_FALSE(container.orders_cached());
+            container.add(3);
+            container.add(-1);
+            container.remove_if([](int x) { return x % 5 == 0; }, policy);
+            container.add(1000);
+            check_ascending(container);
+            container.remove(3);
+            container.remove(-1);
+            check_ascending(container);
+            CHECK(container.size() == 500 - 72 - 86 + 1);
+        }
+
+        MyContainer<int> copy;
+        for (int value : {4, 2, 9, 2, 7}) {
+            copy.add(value);
+        }
+        copy.begin_ascending_order();
+        copy.remove(2);
+        MyContainer<int> moved(std::move(copy));
+        moved.add(1);
+        std::vector<int> ascending(moved.begin_ascending_order(), moved.end_ascending_order());
+        CHECK(ascending == std::vector<int>{1, 4, 7, 9});
+    }
+
+    SUBCASE("Merging removals and pending inserts does not sort from scratch") {
+        size_t comparisons = 0;
+        CountedContainer container(CountingLess{&comparisons});
+        const int n = 2000;
+        for (int i = 0; i < n; ++i) {
+            container.add((i * 101) % n);
+        }
+        container.begin_ascending_order();
+        container.remove_if([](int x) { return x % 7 == 0; });
+        for (int value : {14, -5, 3000, 700}) {
+            container.add(value);
+        }
+        container.remove(3);
+        CHECK_FALSE(container.orders_cached());
+
+        std::vector<int> expected(container.begin(), container.end());
+        std::sort(expected.begin(), expected.end());
+        const CountedContainer& view = container;
+        std::vector<int> materialized(expected.size());
+        comparisons = 0;
+        view.materialize(Order::Ascending, materialized.begin());
+        CHECK(materialized == expected);
+        CHECK(comparisons < 2 * expected.size());
+    }
+
+    SUBCASE("Background sorter merges removals into the cached order") {
+        MyContainer<int> container;
+        for (int i = 0; i < 200; ++i) {
+            container.add((i * 67) % 200);
+        }
+        container.begin_ascending_order();
+        container.enable_background_sorting(std::chrono::milliseconds(1));
+        container.remove(5);
+        REQUIRE(wait_until_cached(container));
+        container.remove(7);
+        container.add(-1);
+        std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        std::vector<int> expected(container.begin(), container.end());
+        std::sort(expected.begin(), expected.end());
+        CHECK(ascending == expected);
+    }
+
+    SUBCASE("Background sorter warms the cache after a quiet period") {
+        MyContainer<int> container;
+        container.enable_background_sorting(std::chrono::milliseconds(1));
+        CHECK(container.background_sorting());
+        for (int i = 100; i > 0; --i) {
+            container.add(i);
+        }
+        REQUIRE(wait_until_cached(container));
+        int expected = 1;
+        for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); ++it) {
+            CHECK(*it == expected++);
+        }
+        container.remove(50);
+        REQUIRE(wait_until_cached(container));
+        std::vector<int> side_cross;
+        for (auto it = container.begin_side_cross_order(); it != container.end_side_cross_order(); ++it) {
+            side_cross.push_back(*it);
+        }
+        CHECK(side_cross.size() == 99);
+        CHECK(side_cross[0] == 1);
+        CHECK(side_cross[1] == 100);
+        container.disable_background_sorting();
+        CHECK_FALSE(container.background_sorting());
+    }
+
+    SUBCASE("Copies and moves keep elements and background sorting") {
+        MyContainer<int> original;
+        original.enable_background_sorting(std::chrono::milliseconds(1));
+        original.add(2);
+        original.add(1);
+        MyContainer<int> copy(original);
+        CHECK(copy.background_sorting());
+        CHECK(copy.size() == 2);
+        MyContainer<int> moved(std::move(copy));
+        CHECK(moved.background_sorting());
+        CHECK_FALSE(copy.background_sorting());
+        CHECK(moved.size() == 2);
+        REQUIRE(wait_until_cached(moved));
+        CHECK(*moved.begin_ascending_order() == 1);
+        original = moved;
+        CHECK(original.size() == 2);
+    }
+
+    SUBCASE("Moves do not throw, so vectors of containers move on growth") {
+        static_assert(std::is_nothrow_move_constructible<MyContainer<int>>::value, "");
+        static_assert(std::is_nothrow_move_assignable<MyContainer<int>>::value, "");
+        static_assert(std::is_nothrow_move_constructible<pmr::MyContainer<int>>::value, "");
+        static_assert(std::is_nothrow_move_constructible<SmallMyContainer<int, 4>>::value, "");
+        std::vector<MyContainer<int>> containers(1);
+        for (int value : {3, 1, 2}) {
+            containers[0].add(value);
+        }
+        containers[0].begin_ascending_order();
+        containers[0].enable_background_sorting(std::chrono::milliseconds(1));
+        const int* storage = &*containers[0].begin();
+        for (int i = 0; i < 40; ++i) {
+            containers.emplace_back();
+        }
+        CHECK(&*containers[0].begin() == storage);
+        CHECK(containers[0].background_sorting());
+        CHECK(containers[0].orders_cached());
+        CHECK(*containers[0].begin_ascending_order() == 1);
+    }
+}
+
+namespace {
+
+/// Memory resource counting the allocations it forwards to the heap
+class CountingResource : public std::pmr::memory_resource {
+public:
+    size_t allocations = 0;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        ++allocations;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+/// Makes every allocation from the default memory resource fail while alive
+struct NoDefaultResource {
+    std::pmr::memory_resource* previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+    ~NoDefaultResource() { std::pmr::set_default_resource(previous); }
+};
+
+} // namespace
+
+TEST_CASE("Allocator-aware containers") {
+    SUBCASE("pmr container allocates elements and orderings from its resource") {
+        CountingResource resource;
+        NoDefaultResource guard;
+        pmr::MyContainer<int> container(&resource);
+        container.add(5);
+        container.add(3);
+        container.add(8);
+        size_t after_adds = resource.allocations;
+        CHECK(after_adds > 0);
+
+        std::vector<int> ascending;
+        for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); ++it) {
+            ascending.push_back(*it);
+        }
+        CHECK(ascending == std::vector<int>{3, 5, 8});
+        std::vector<int> middle_out;
+        for (auto it = container.begin_middle_out_order(); it != container.end_middle_out_order(); it++) {
+            middle_out.push_back(*it);
+        }
+        CHECK(middle_out == std::vector<int>{3, 5, 8});
+        CHECK(resource.allocations > after_adds);
+
+        auto producer = container.stream(Order::SideCross, 2);
+        CHECK(producer.next());
+        container.remove_if([](int x) { return x > 4; }, ExecutionPolicy{2, 1});
+        CHECK(container.size() == 1);
+    }
+
+    SUBCASE("Merging pending elements into the cached order uses the container's resource") {
+        CountingResource resource;
+        pmr::MyContainer<int> container(&resource);
+        std::vector<int> expected;
+        for (int i = 0; i < 1000; ++i) {
+            container.add((i * 7919) % 1000);
+            expected.push_back((i * 7919) % 1000);
+        }
+        container.begin_ascending_order();
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 0; i < 300; ++i) {
+                container.add((i * 613 + round) % 1200 - 100);
+                expected.push_back((i * 613 + round) % 1200 - 100);
+            }
+            size_t before = resource.allocations;
+            std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+            CHECK(resource.allocations > before);
+            std::sort(expected.begin(), expected.end());
+            CHECK(ascending == expected);
+        }
+    }
+
+    SUBCASE("Copies use the propagated allocator, moves keep the source's") {
+        CountingResource resource;
+        pmr::MyContainer<int> container(&resource);
+        container.add(1);
+        pmr::MyContainer<int> moved(std::move(container));
+        CHECK(moved.get_allocator().resource() == &resource);
+        pmr::MyContainer<int> copy(moved);
+        CHECK(copy.get_allocator().resource() == std::pmr::get_default_resource());
+        CHECK(copy.size() == 1);
+    }
+
+    SUBCASE("Monotonic arena backed container") {
+        std::byte buffer[4096];
+        std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+        pmr::MyContainer<int> container(&arena);
+        for (int i = 10; i > 0; --i) {
+            container.add(i);
+        }
+        int expected = 10;
+        for (auto it = container.begin_descending_order(); it != container.end_descending_order(); ++it) {
+            CHECK(*it == expected--);
+        }
+    }
+}
+
+TEST_CASE("Scratch buffers for iterator construction") {
+    SUBCASE("Steady-state traversals do not allocate") {
+        CountingResource resource;
+        pmr::MyContainer<int> container(&resource);
+        for (int i = 0; i < 100; ++i) {
+            container.add((i * 13) % 100);
+        }
+        auto traverse_all = [&container]() {
+            long sum = 0;
+            for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); it++) {
+                sum += *it;
+            }
+            for (auto it = container.begin_descending_order(); it != container.end_descending_order(); ++it) {
+                sum += *it;
+            }
+            for (auto it = container.begin_side_cross_order(); it != container.end_side_cross_order(); ++it) {
+                sum += *it;
+            }
+            for (auto it = container.begin_reverse_order(); it != container.end_reverse_order(); ++it) {
+                sum += *it;
+            }
+            for (int value : container) {
+                sum += value;
+            }
+            for (auto it = container.begin_middle_out_order(); it != container.end_middle_out_order(); ++it) {
+                sum += *it;
+            }
+            return sum;
+        };
+        long expected = traverse_all();
+        size_t warmed_up = resource.allocations;
+        CHECK(traverse_all() == expected);
+        CHECK(traverse_all() == expected);
+        CHECK(resource.allocations == warmed_up);
+    }
+
+    SUBCASE("Assigning iterators across containers keeps buffers with their own pools") {
+        CountingResource first_resource;
+        CountingResource second_resource;
+        pmr::MyContainer<int> first(&first_resource);
+        pmr::MyContainer<int> second(&second_resource);
+        for (int i = 0; i < 100; ++i) {
+            first.add((i * 13) % 100);
+            second.add((i * 7) % 100 + 1);
+        }
+        auto traverse = [](pmr::MyContainer<int>& container) {
+            long sum = 0;
+            for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); ++it) {
+                sum += *it;
+            }
+            return sum;
+        };
+        traverse(first);
+        traverse(second);
+        {
+            auto copied = second.begin_ascending_order();
+            auto moved = second.begin_ascending_order();
+            auto source = first.begin_ascending_order();
+            copied = source;
+            moved = std::move(source);
+            CHECK(*copied == 0);
+            CHECK(*++moved == 1);
+        }
+        size_t first_allocations = first_resource.allocations;
+        size_t second_allocations = second_resource.allocations;
+        CHECK(traverse(first) == traverse(second) - 100);
+        CHECK(first_resource.allocations == first_allocations);
+        CHECK(second_resource.allocations == second_allocations);
+    }
+
+    SUBCASE("Iterators may be destroyed after the container") {
+        MyContainer<int>::AscendingIterator* it = nullptr;
+        {
+            MyContainer<int> container;
+            for (int i = 0; i < 50; ++i) {
+                container.add(50 - i);
+            }
+            it = new MyContainer<int>::AscendingIterator(container.begin_ascending_order());
+            CHECK(**it == 1);
+        }
+        ++*it;
+        MyContainer<int>::AscendingIterator copy(*it);
+        CHECK(copy == *it);
+        delete it;
+    }
+}
+
+TEST_CASE("Small-buffer optimized containers") {
+    using SmallPmrContainer = MyContainer<int, std::pmr::polymorphic_allocator<int>, 8>;
+
+    SUBCASE("Small contents and their orderings stay in-object") {
+        CountingResource resource;
+        SmallPmrContainer container(&resource);
+        for (int value : {5, 3, 8, 1, 9, 2}) {
+            container.add(value);
+        }
+        std::vector<int> ascending;
+        for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); it++) {
+            ascending.push_back(*it);
+        }
+        std::vector<int> side_cross;
+        for (auto it = container.begin_side_cross_order(); it != container.end_side_cross_order(); ++it) {
+            side_cross.push_back(*it);
+        }
+        std::vector<int> middle_out;
+        for (auto it = container.begin_middle_out_order(); it != container.end_middle_out_order(); ++it) {
+            middle_out.push_back(*it);
+        }
+        container.remove(8);
+        CHECK(ascending == std::vector<int>{1, 2, 3, 5, 8, 9});
+        CHECK(side_cross == std::vector<int>{1, 9, 2, 8, 3, 5});
+        CHECK(middle_out == std::vector<int>{1, 8, 9, 3, 2, 5});
+        CHECK(container.size() == 5);
+        CHECK(resource.allocations == 0);
+    }
+
+    SUBCASE("Growing past the inline capacity falls back to the heap") {
+        CountingResource resource;
+        SmallPmrContainer container(&resource);
+        for (int i = 20; i > 0; --i) {
+            container.add(i);
+        }
+        CHECK(resource.allocations > 0);
+        int expected = 1;
+        for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); ++it) {
+            CHECK(*it == expected++);
+        }
+        container.remove_if([](int x) { return x > 4; });
+        std::vector<int> reverse;
+        for (auto it = container.begin_reverse_order(); it != container.end_reverse_order(); ++it) {
+            reverse.push_back(*it);
+        }
+        CHECK(reverse == std::vector<int>{1, 2, 3, 4});
+    }
+
+    SUBCASE("Copies and moves of small containers") {
+        SmallMyContainer<std::string, 4> words;
+        words.add("pear");
+        words.add("apple");
+        SmallMyContainer<std::string, 4> copy(words);
+        SmallMyContainer<std::string, 4> moved(std::move(words));
+        copy.add("fig");
+        CHECK(copy.size() == 3);
+        CHECK(moved.size() == 2);
+        CHECK(*moved.begin_ascending_order() == "apple");
+        moved = copy;
+        CHECK(moved.size() == 3);
+        for (int i = 0; i < 10; ++i) {
+            moved.add(std::to_string(i));
+        }
+        copy = std::move(moved);
+        CHECK(copy.size() == 13);
+        CHECK(*copy.begin_descending_order() == "pear");
+    }
+}
+
+TEST_CASE("Fixed-capacity static container") {
+    StaticMyContainer<int, 8> container;
+    container.add(7);
+    container.add(15);
+    container.add(6);
+    container.add(1);
+    container.add(2);
+
+    auto collect = [](auto begin, auto end) {
+        std::vector<int> values;
+        for (; begin != end; ++begin) {
+            values.push_back(*begin);
+        }
+        return values;
+    };
+
+    SUBCASE("All six orders match MyContainer") {
+        CHECK(collect(container.begin_ascending_order(), container.end_ascending_order()) ==
+              std::vector<int>{1, 2, 6, 7, 15});
+        CHECK(collect(container.begin_descending_order(), container.end_descending_order()) ==
+              std::vector<int>{15, 7, 6, 2, 1});
+        CHECK(collect(container.begin_side_cross_order(), container.end_side_cross_order()) ==
+              std::vector<int>{1, 15, 2, 7, 6});
+        CHECK(collect(container.begin_reverse_order(), container.end_reverse_order()) ==
+              std::vector<int>{2, 1, 6, 15, 7});
+        CHECK(collect(container.begin_order(), container.end_order()) ==
+              std::vector<int>{7, 15, 6, 1, 2});
+        CHECK(collect(container.begin_middle_out_order(), container.end_middle_out_order()) ==
+              std::vector<int>{6, 15, 1, 7, 2});
+    }
+
+    SUBCASE("Capacity is enforced") {
+        CHECK(StaticMyContainer<int, 8>::capacity() == 8);
+        container.add(3);
+        container.add(4);
+        container.add(5);
+        CHECK(container.size() == 8);
+        CHECK_THROWS_AS(container.add(9), std::runtime_error);
+    }
+
+    SUBCASE("Remove keeps insertion order and frees capacity") {
+        container.add(6);
+        container.remove(6);
+        CHECK(container.size() == 4);
+        CHECK_THROWS_AS(container.remove(6), std::runtime_error);
+        CHECK(collect(container.begin(), container.end()) == std::vector<int>{7, 15, 1, 2});
+        std::ostringstream os;
+        os << container;
+        CHECK(os.str() == "[7, 15, 1, 2]");
+    }
+
+    SUBCASE("Iterators read the container's elements through const references") {
+        using Ascending = StaticMyContainer<std::string, 4>::AscendingIterator;
+        static_assert(std::is_same<std::iterator_traits<Ascending>::reference, const std::string&>::value, "");
+        static_assert(std::is_same<decltype(std::declval<Ascending&>().operator->()), const std::string*>::value, "");
+        static_assert(std::is_default_constructible<Ascending>::value, "");
+        StaticMyContainer<std::string, 4> words;
+        words.add("pear");
+        words.add("fig");
+        Ascending it;
+        it = words.begin_ascending_order();
+        CHECK(it->size() == 3);
+        CHECK(&*it == &*++words.begin_order());
+        CHECK(*++it == "pear");
+    }
+
+    SUBCASE("Empty static container iterators") {
+        StaticMyContainer<std::string, 4> empty;
+        CHECK(empty.begin_side_cross_order() == empty.end_side_cross_order());
+        CHECK(empty.begin_middle_out_order() == empty.end_middle_out_order());
+    }
+}
+
+namespace {
+
+/// Even insertion positions first, then odd ones
+struct EvensThenOdds {
+    static constexpr bool sorted = false;
+    static constexpr size_t index(size_t n, size_t pos) {
+        size_t evens = (n + 1) / 2;
+        return pos < evens ? pos * 2 : (pos - evens) * 2 + 1;
+    }
+};
+
+/// Largest value first, then the remaining values in ascending order
+struct MaxThenAscending {
+    static constexpr bool sorted = true;
+    static constexpr size_t index(size_t n, size_t pos) {
+        return pos == 0 ? n - 1 : pos - 1;
+    }
+};
+
+} // namespace
+
+TEST_CASE("Iteration-order policies") {
+    SUBCASE("Built-in iterators are instances of the policy iterator") {
+        CHECK(std::is_same_v<MyContainer<int>::AscendingIterator,
+                             MyContainer<int>::Iterator<OrderPolicy<Order::Ascending>>>);
+        CHECK(std::is_same_v<MyContainer<int>::MiddleOutIterator,
+                             MyContainer<int>::Iterator<OrderPolicy<Order::MiddleOut>>>);
+        CHECK(std::is_same_v<StaticMyContainer<int, 4>::ReverseIterator,
+                             StaticMyContainer<int, 4>::Iterator<OrderPolicy<Order::Reverse>>>);
+    }
+
+    SUBCASE("User-defined insertion-based order") {
+        MyContainer<int> container;
+        for (int value : {10, 11, 12, 13, 14}) {
+            container.add(value);
+        }
+        std::vector<int> result;
+        for (auto it = container.begin_custom_order<EvensThenOdds>();
+             it != container.end_custom_order<EvensThenOdds>(); ++it) {
+            result.push_back(*it);
+        }
+        CHECK(result == std::vector<int>{10, 12, 14, 11, 13});
+    }
+
+    SUBCASE("User-defined sorted order") {
+        MyContainer<int> container;
+        for (int value : {4, 9, 1, 7}) {
+            container.add(value);
+        }
+        std::vector<int> result;
+        for (auto it = container.begin_custom_order<MaxThenAscending>();
+             it != container.end_custom_order<MaxThenAscending>(); it++) {
+            result.push_back(*it);
+        }
+        CHECK(result == std::vector<int>{9, 1, 4, 7});
+    }
+
+    SUBCASE("Custom orders on the static container") {
+        StaticMyContainer<int, 8> container;
+        for (int value : {3, 8, 5}) {
+            container.add(value);
+        }
+        std::vector<int> result;
+        for (auto it = container.begin_custom_order<MaxThenAscending>();
+             it != container.end_custom_order<MaxThenAscending>(); ++it) {
+            result.push_back(*it);
+        }
+        CHECK(result == std::vector<int>{8, 3, 5});
+    }
+
+    SUBCASE("Empty container") {
+        MyContainer<int> container;
+        CHECK(container.begin_custom_order<EvensThenOdds>() == container.end_custom_order<EvensThenOdds>());
+    }
+}
+
+namespace {
+
+struct Record {
+    int id;
+    std::string name;
+};
+
+/// Orders integers by their last decimal digit
+struct LastDigitLess {
+    int base;
+    bool operator()(int a, int b) const { return a % base < b % base; }
+};
+
+} // namespace
+
+TEST_CASE("Custom comparators and projections") {
+    SUBCASE("Compare template parameter") {
+        MyContainer<int, std::allocator<int>, 0, std::greater<int>> container;
+        for (int value : {3, 1, 4, 1, 5}) {
+            container.add(value);
+        }
+        std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        std::vector<int> descending(container.begin_descending_order(), container.end_descending_order());
+        std::vector<int> side_cross(container.begin_side_cross_order(), container.end_side_cross_order());
+        CHECK(ascending == std::vector<int>{5, 4, 3, 1, 1});
+        CHECK(descending == std::vector<int>{1, 1, 3, 4, 5});
+        CHECK(side_cross == std::vector<int>{5, 1, 4, 1, 3});
+
+        std::vector<int> materialized(5);
+        container.materialize(Order::Ascending, materialized.begin());
+        CHECK(materialized == ascending);
+
+        std::vector<int> streamed;
+        container.for_each_chunk(Order::Ascending, [&](const int* data, size_t count) {
+            streamed.insert(streamed.end(), data, data + count);
+        }, 2);
+        CHECK(streamed == ascending);
+    }
+
+    SUBCASE("Stateful comparator passed to the constructor") {
+        MyContainer<int, std::allocator<int>, 0, LastDigitLess> container(LastDigitLess{10});
+        for (int value : {19, 21, 35, 42}) {
+            container.add(value);
+        }
+        CHECK(container.value_comp().base == 10);
+        std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == std::vector<int>{21, 42, 35, 19});
+
+        auto copy = container;
+        std::vector<int> copied(copy.begin_descending_order(), copy.end_descending_order());
+        CHECK(copied == std::vector<int>{19, 35, 42, 21});
+    }
+
+    SUBCASE("Per-call projection onto a member") {
+        MyContainer<Record> container;
+        container.add(Record{3, "carol"});
+        container.add(Record{1, "dave"});
+        container.add(Record{2, "alice"});
+        container.add(Record{4, "bob"});
+
+        std::vector<int> by_id;
+        for (auto it = container.begin_ascending_order(std::less<>(), &Record::id);
+             it != container.end_ascending_order(); ++it) {
+            by_id.push_back(it->id);
+        }
+        CHECK(by_id == std::vector<int>{1, 2, 3, 4});
+
+        std::vector<std::string> by_name;
+        for (auto it = container.begin_descending_order(std::less<>(), &Record::name);
+             it != container.end_descending_order(); ++it) {
+            by_name.push_back(it->name);
+        }
+        CHECK(by_name == std::vector<std::string>{"dave", "carol", "bob", "alice"});
+    }
+
+    SUBCASE("Per-call comparator overrides the container's ordering") {
+        MyContainer<int> container;
+        for (int value : {8, 3, 6, 1}) {
+            container.add(value);
+        }
+        std::vector<int> side_cross;
+        for (auto it = container.begin_side_cross_order(std::greater<>());
+             it != container.end_side_cross_order(); ++it) {
+            side_cross.push_back(*it);
+        }
+        CHECK(side_cross == std::vector<int>{8, 1, 6, 3});
+
+        // The container's own order (and its cache) is unaffected
+        std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == std::vector<int>{1, 3, 6, 8});
+    }
+
+    SUBCASE("Empty container") {
+        MyContainer<Record> container;
+        CHECK(container.begin_ascending_order(std::less<>(), &Record::id) == container.end_ascending_order());
+    }
+}
+
+namespace {
+
+/// Large element type that counts its copies
+struct Heavy {
+    static int copies;
+    int key;
+    std::array<char, 256> payload{};
+
+    explicit Heavy(int k) : key(k) {}
+    Heavy(const Heavy& other) : key(other.key), payload(other.payload) { ++copies; }
+    Heavy& operator=(const Heavy& other) {
+        key = other.key;
+        payload = other.payload;
+        ++copies;
+        return *this;
+    }
+    bool operator<(const Heavy& other) const { return key < other.key; }
+};
+
+int Heavy::copies = 0;
+
+} // namespace
+
+TEST_CASE("Stable ordering and duplicate groups") {
+    using DigitContainer = MyContainer<int, std::allocator<int>, 0, LastDigitLess>;
+    auto stable_expected = [](DigitContainer& container) {
+        std::vector<int> expected(container.begin(), container.end());
+        std::stable_sort(expected.begin(), expected.end(), container.value_comp());
+        return expected;
+    };
+
+    SUBCASE("Equal elements keep insertion order in every sorted path") {
+        DigitContainer container(LastDigitLess{10});
+        CHECK_FALSE(container.stable_ordering());
+        container.enable_stable_ordering();
+        CHECK(container.stable_ordering());
+        for (int i = 0; i < 1000; ++i) {
+            container.add((i * 7919) % 1000);
+        }
+        std::vector<int> expected = stable_expected(container);
+        std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == expected);
+        std::vector<int> descending(container.begin_descending_order(), container.end_descending_order());
+        CHECK(std::equal(descending.begin(), descending.end(), expected.rbegin()));
+
+        std::vector<int> streamed;
+        container.for_each_chunk(Order::Ascending, [&](const int* data, size_t count) {
+            streamed.insert(streamed.end(), data, data + count);
+        }, 64);
+        CHECK(streamed == expected);
+
+        for (int value : {5, 15, 0, 999}) {
+            container.add(value);
+        }
+        container.remove(7);
+        expected = stable_expected(container);
+        const DigitContainer& view = container;
+        std::vector<int> materialized(expected.size());
+        view.materialize(Order::Ascending, materialized.begin(), ExecutionPolicy{4, 16});
+        CHECK(materialized == expected);
+        ascending.assign(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == expected);
+
+        std::vector<int> by_tens(container.begin_ascending_order(LastDigitLess{100}), container.end_ascending_order());
+        std::vector<int> tens_expected(container.begin(), container.end());
+        std::stable_sort(tens_expected.begin(), tens_expected.end(), LastDigitLess{100});
+        CHECK(by_tens == tens_expected);
+    }
+
+    SUBCASE("Enabling stable ordering discards an unstable cache") {
+        DigitContainer container(LastDigitLess{10});
+        for (int i = 0; i < 300; ++i) {
+            container.add((i * 37) % 300);
+        }
+        container.begin_ascending_order();
+        container.enable_stable_ordering();
+        CHECK_FALSE(container.orders_cached());
+        std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == stable_expected(container));
+        container.disable_stable_ordering();
+        CHECK(container.orders_cached());
+    }
+
+    SUBCASE("equal_ranges yields each value once with its count") {
+        MyContainer<int> container;
+        for (int value : {3, 1, 3, 3, 2, 1}) {
+            container.add(value);
+        }
+        std::vector<std::pair<int, size_t>> groups;
+        for (auto [value, count] : container.equal_ranges()) {
+            groups.emplace_back(value, count);
+        }
+        CHECK(groups == std::vector<std::pair<int, size_t>>{{1, 2}, {2, 1}, {3, 3}});
+
+        MyContainer<int> empty;
+        auto range = empty.equal_ranges();
+        CHECK(range.begin() == range.end());
+    }
+
+    SUBCASE("equal_ranges groups by the comparator") {
+        DigitContainer container(LastDigitLess{10});
+        container.enable_stable_ordering();
+        for (int value : {21, 13, 11, 3, 31, 40}) {
+            container.add(value);
+        }
+        std::vector<std::pair<int, size_t>> groups;
+        auto range = container.equal_ranges();
+        for (auto it = range.begin(); it != range.end(); ++it) {
+            groups.emplace_back((*it).first, (*it).second);
+        }
+        CHECK(groups == std::vector<std::pair<int, size_t>>{{40, 1}, {21, 3}, {13, 2}});
+    }
+}
+
+TEST_CASE("Binary search queries") {
+    SUBCASE("Bounds match std::lower_bound and std::upper_bound") {
+        for (int n : {0, 1, 5, 63, 64, 65, 1000}) {
+            MyContainer<int> container;
+            std::vector<int> sorted;
+            for (int i = 0; i < n; ++i) {
+                int value = (i * 37) % (n / 2 + 1) * 2;  // even values, most of them repeated
+                container.add(value);
+                sorted.push_back(value);
+            }
+            std::sort(sorted.begin(), sorted.end());
+            for (int probe = -2; probe <= n + 2; ++probe) {
+                size_t lower = static_cast<size_t>(std::lower_bound(sorted.begin(), sorted.end(), probe) - sorted.begin());
+                size_t upper = static_cast<size_t>(std::upper_bound(sorted.begin(), sorted.end(), probe) - sorted.begin());
+                CHECK(container.lower_bound(probe) == lower);
+                CHECK(container.upper_bound(probe) == upper);
+                CHECK(container.count(probe) == upper - lower);
+                CHECK(container.contains(probe) == (upper > lower));
+            }
+        }
+    }
+
+    SUBCASE("Eytzinger layout gives the same answers") {
+        for (int n : {0, 1, 2, 3, 7, 8, 100, 1000}) {
+            MyContainer<int> container;
+            container.enable_eytzinger_search();
+            CHECK(container.eytzinger_search());
+            std::vector<int> sorted;
+            for (int i = 0; i < n; ++i) {
+                container.add((i * 37) % (n / 2 + 1) * 2);
+                sorted.push_back((i * 37) % (n / 2 + 1) * 2);
+            }
+            for (int round = 0; round < 2; ++round) {
+                std::sort(sorted.begin(), sorted.end());
+                for (int probe = -2; probe <= n + 4; ++probe) {
+                    auto lower = std::lower_bound(sorted.begin(), sorted.end(), probe);
+                    auto upper = std::upper_bound(sorted.begin(), sorted.end(), probe);
+                    CHECK(container.lower_bound(probe) == static_cast<size_t>(lower - sorted.begin()));
+                    CHECK(container.upper_bound(probe) == static_cast<size_t>(upper - sorted.begin()));
+                    CHECK(container.contains(probe) == (upper > lower));
+                }
+                container.add(n + 3);  // extends the cached order; the layout is rebuilt
+                sorted.push_back(n + 3);
+            }
+        }
+
+        MyContainer<std::string, std::allocator<std::string>, 0, std::greater<std::string>> words;
+        words.enable_eytzinger_search();
+        for (const char* word : {"kiwi", "apple", "fig", "pear", "fig"}) {
+            words.add(word);
+        }
+        CHECK(words.lower_bound("fig") == 2);
+        CHECK(words.count("fig") == 2);
+        CHECK(words.count("plum") == 0);
+        words.disable_eytzinger_search();
+        CHECK(words.range("pear", "apple") == std::pair<size_t, size_t>{0, 4});
+    }
+
+    SUBCASE("Queries follow mutations and the comparator") {
+        MyContainer<int, std::allocator<int>, 0, std::greater<int>> container;
+        for (int value : {4, 9, 4, 1, 7}) {
+            container.add(value);
+        }
+        CHECK(container.lower_bound(4) == 2);
+        CHECK(container.upper_bound(4) == 4);
+        CHECK(container.count(4) == 2);
+        container.remove(4);
+        CHECK_FALSE(container.contains(4));
+        container.add(4);
+        CHECK(container.count(4) == 1);
+        CHECK(container.contains(1));
+        CHECK_FALSE(container.contains(2));
+    }
+
+    SUBCASE("range gives ascending positions of an interval") {
+        MyContainer<int> container;
+        for (int value : {8, 3, 5, 1, 9, 5, 2}) {
+            container.add(value);
+        }
+        auto [first, last] = container.range(3, 9);
+        CHECK(first == 2);
+        CHECK(last == 6);
+        std::vector<int> values;
+        container.for_each(Order::Ascending, first, last, [&](int value) { values.push_back(value); });
+        CHECK(values == std::vector<int>{3, 5, 5, 8});
+        auto empty = container.range(6, 4);
+        CHECK(empty.first == empty.second);
+    }
+}
+
+TEST_CASE("Range views over the sorted order") {
+    SUBCASE("Range and group iterators meet the requirements of their categories") {
+        using Ranges = MyContainer<int>::RangeIterator;
+        using Groups = MyContainer<int>::GroupIterator;
+        static_assert(std::is_default_constructible<Ranges>::value, "");
+        static_assert(std::is_default_constructible<Groups>::value, "");
+        static_assert(std::is_same<std::iterator_traits<Groups>::difference_type, std::ptrdiff_t>::value, "");
+#if defined(__cpp_lib_ranges)
+        static_assert(std::forward_iterator<Ranges>);
+        static_assert(std::input_iterator<Groups>);
+#endif
+        MyContainer<int> container;
+        for (int value : {4, 2, 4}) {
+            container.add(value);
+        }
+        Ranges it;
+        it = container.ascending_range(0, 10).begin();
+        CHECK(*it == 2);
+        Groups group;
+        group = container.equal_ranges().begin();
+        CHECK(group->first == 2);
+        ++group;
+        CHECK(group->first == 4);
+        CHECK(group->second == 2);
+    }
+
+    SUBCASE("Half-open intervals in both directions") {
+        MyContainer<int> container;
+        for (int value : {8, 3, 5, 1, 9, 5, 2, 3}) {
+            container.add(value);
+        }
+        for (bool eytzinger : {false, true}) {
+            if (eytzinger) {
+                container.enable_eytzinger_search();
+            }
+            auto up = container.ascending_range(3, 8);
+            CHECK(std::vector<int>(up.begin(), up.end()) == std::vector<int>{3, 3, 5, 5});
+            auto down = container.descending_range(8, 3);
+            CHECK(std::vector<int>(down.begin(), down.end()) == std::vector<int>{8, 5, 5});
+            auto all = container.descending_range(100, -100);
+            CHECK(std::distance(all.begin(), all.end()) == 8);
+            CHECK(*all.begin() == 9);
+            auto none = container.ascending_range(6, 8);
+            CHECK(none.begin() == none.end());
+            auto inverted = container.descending_range(2, 7);
+            CHECK(inverted.begin() == inverted.end());
+        }
+    }
+
+    SUBCASE("Views read the elements in place") {
+        MyContainer<std::string> words;
+        for (const char* word : {"pear", "fig", "kiwi", "apple"}) {
+            words.add(word);
+        }
+        std::vector<const std::string*> addresses;
+        for (auto it = words.begin(); it != words.end(); ++it) {
+            addresses.push_back(&*it);
+        }
+        auto view = words.ascending_range("b", "l");
+        auto it = view.begin();
+        CHECK(&*it == addresses[1]);
+        CHECK(it->size() == 3);
+        ++it;
+        CHECK(&*it == addresses[2]);
+        CHECK(++it == view.end());
+    }
+
+    SUBCASE("Intervals follow the comparator") {
+        MyContainer<int, std::allocator<int>, 0, std::greater<int>> container;
+        for (int value : {4, 9, 4, 1, 7}) {
+            container.add(value);
+        }
+        auto up = container.ascending_range(7, 1);
+        CHECK(std::vector<int>(up.begin(), up.end()) == std::vector<int>{7, 4, 4});
+        auto down = container.descending_range(1, 7);
+        CHECK(std::vector<int>(down.begin(), down.end()) == std::vector<int>{1, 4, 4});
+    }
+}
+
+TEST_CASE("Erasing and updating through iterators") {
+    auto check_orders = [](MyContainer<int>& container, const std::vector<int>& insertion) {
+        CHECK(std::vector<int>(container.begin(), container.end()) == insertion);
+        std::vector<int> expected = insertion;
+        std::stable_sort(expected.begin(), expected.end());
+        std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        if (container.stable_ordering()) {
+            std::vector<const int*> addresses;
+            for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); ++it) {
+                addresses.push_back(&*it);
+            }
+            std::vector<size_t> order(insertion.size());
+            for (size_t i = 0; i < order.size(); ++i) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return insertion[a] < insertion[b]; });
+            const int* first = &*container.begin();
+            for (size_t i = 0; i < order.size(); ++i) {
+                CHECK(addresses[i] == first + order[i]);
+            }
+        }
+        CHECK(ascending == expected);
+    };
+
+    SUBCASE("erase removes exactly the element an iterator points to") {
+        MyContainer<int> container;
+        std::vector<int> insertion{5, 2, 9, 2, 7, 4};
+        for (int value : insertion) {
+            container.add(value);
+        }
+        container.begin_ascending_order();
+        auto it = container.begin_ascending_order();
+        ++it;  // one of the two 2s
+        size_t index = static_cast<size_t>(&*it - &*container.begin());
+        container.erase(it);
+        CHECK(container.orders_cached());
+        CHECK(container.count(2) == 1);
+        insertion.erase(insertion.begin() + static_cast<std::ptrdiff_t>(index));
+        check_orders(container, insertion);
+
+        MyContainer<int> fresh;
+        for (int value : {5, 2, 9, 2, 7, 4}) {
+            fresh.add(value);
+        }
+        fresh.erase(++fresh.begin_order());                  // insertion position 1
+        fresh.erase(fresh.begin_side_cross_order());         // the smallest, the remaining 2
+        fresh.erase(++fresh.begin_reverse_order());          // 7
+        std::vector<int> remaining{5, 9, 4};
+        check_orders(fresh, remaining);
+        auto view = fresh.descending_range(100, 0);
+        fresh.erase(view.begin());                           // 9
+        remaining = {5, 4};
+        check_orders(fresh, remaining);
+    }
+
+    SUBCASE("erase returns the next element, so a traversal can erase as it goes") {
+        std::vector<int> insertion;
+        for (int i = 0; i < 60; ++i) {
+            insertion.push_back((i * 37) % 50);
+        }
+        std::vector<int> kept;
+        std::copy_if(insertion.begin(), insertion.end(), std::back_inserter(kept), [](int x) { return x % 3 != 0; });
+        auto walk_and_erase = [&](auto begin, auto end) {
+            MyContainer<int> container;
+            for (int value : insertion) {
+                container.add(value);
+            }
+            std::vector<int> full(begin(container), end(container));
+            std::vector<int> visited;
+            for (auto it = begin(container); it != end(container);) {
+                visited.push_back(*it);
+                if (*it % 3 == 0) {
+                    it = container.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            CHECK(visited == full);
+            CHECK(std::vector<int>(container.begin(), container.end()) == kept);
+            std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+            CHECK(std::is_sorted(ascending.begin(), ascending.end()));
+            CHECK(ascending.size() == kept.size());
+        };
+        walk_and_erase([](MyContainer<int>& c) { return c.begin_order(); },
+                       [](MyContainer<int>& c) { return c.end_order(); });
+        walk_and_erase([](MyContainer<int>& c) { return c.begin_reverse_order(); },
+                       [](MyContainer<int>& c) { return c.end_reverse_order(); });
+        walk_and_erase([](MyContainer<int>& c) { return c.begin_middle_out_order(); },
+                       [](MyContainer<int>& c) { return c.end_middle_out_order(); });
+        walk_and_erase([](MyContainer<int>& c) { return c.begin_ascending_order(); },
+                       [](MyContainer<int>& c) { return c.end_ascending_order(); });
+        walk_and_erase([](MyContainer<int>& c) { return c.begin_descending_order(); },
+                       [](MyContainer<int>& c) { return c.end_descending_order(); });
+        walk_and_erase([](MyContainer<int>& c) { return c.begin_side_cross_order(); },
+                       [](MyContainer<int>& c) { return c.end_side_cross_order(); });
+    }
+
+    SUBCASE("erase through range views keeps the view's end valid") {
+        MyContainer<int> container;
+        for (int i = 0; i < 40; ++i) {
+            container.add((i * 17) % 40);
+        }
+        auto up = container.ascending_range(10, 30);
+        for (auto it = up.begin(); it != up.end();) {
+            it = *it % 2 != 0 ? container.erase(it) : std::next(it);
+        }
+        auto down = container.descending_range(30, 10);
+        std::vector<int> walked;
+        for (auto it = down.begin(); it != down.end();) {
+            walked.push_back(*it);
+            it = *it % 4 == 0 ? container.erase(it) : std::next(it);
+        }
+        CHECK(walked == std::vector<int>{30, 28, 26, 24, 22, 20, 18, 16, 14, 12});
+        CHECK(container.orders_cached());
+        std::vector<int> expected;
+        for (int value = 0; value < 40; ++value) {
+            bool dropped = (value >= 10 && value < 30 && value % 2 != 0) ||
+                           (value > 10 && value <= 30 && value % 4 == 0);
+            if (!dropped) {
+                expected.push_back(value);
+            }
+        }
+        CHECK(std::vector<int>(container.begin_ascending_order(), container.end_ascending_order()) == expected);
+    }
+
+    SUBCASE("update locates duplicates through sorted-order iterators") {
+        MyContainer<int> container;
+        std::vector<int> insertion(200, 5);
+        for (int value : insertion) {
+            container.add(value);
+        }
+        container.add(1);
+        insertion.push_back(1);
+        container.begin_ascending_order();
+        for (int step = 0; step < 50; ++step) {
+            auto it = container.begin_ascending_order();
+            std::advance(it, 100 + step);
+            size_t index = static_cast<size_t>(&*it - &*container.begin());
+            container.update(it, step % 2 == 0 ? 9 : 0);
+            insertion[index] = step % 2 == 0 ? 9 : 0;
+            CHECK(container.orders_cached());
+        }
+        check_orders(container, insertion);
+    }
+
+    SUBCASE("erase rejects end iterators and foreign iterators") {
+        MyContainer<int> container;
+        container.add(1);
+        MyContainer<int> other;
+        other.add(1);
+        CHECK_THROWS_AS(container.erase(container.end_ascending_order()), std::out_of_range);
+        CHECK_THROWS_AS(container.erase(other.begin()), std::out_of_range);
+        CHECK_THROWS_AS(container.update(container.end(), 3), std::out_of_range);
+        auto empty = container.ascending_range(5, 9);
+        CHECK_THROWS_AS(container.erase(empty.begin()), std::out_of_range);
+        CHECK(container.size() == 1);
+    }
+
+    SUBCASE("update repairs a warm cache in place") {
+        for (bool stable : {false, true}) {
+            MyContainer<int> container;
+            if (stable) {
+                container.enable_stable_ordering();
+            }
+            std::vector<int> insertion;
+            for (int i = 0; i < 300; ++i) {
+                container.add((i * 53) % 40);
+                insertion.push_back((i * 53) % 40);
+            }
+            container.enable_hash_index();
+            container.begin_ascending_order();
+            for (int step = 0; step < 200; ++step) {
+                size_t position = static_cast<size_t>(step * 131) % insertion.size();
+                int value = (step * 17) % 45 - 2;
+                auto it = container.begin_order();
+                std::advance(it, static_cast<std::ptrdiff_t>(position));
+                container.update(it, value);
+                insertion[position] = value;
+                CHECK(container.orders_cached());
+            }
+            check_orders(container, insertion);
+            CHECK(container.count(7) == static_cast<size_t>(std::count(insertion.begin(), insertion.end(), 7)));
+
+            auto by_rank = container.begin_ascending_order();
+            std::advance(by_rank, 10);
+            size_t index = static_cast<size_t>(&*by_rank - &*container.begin());
+            container.update(by_rank, 1000);
+            insertion[index] = 1000;
+            check_orders(container, insertion);
+        }
+    }
+
+    SUBCASE("update with a cold or pending cache and in-order data") {
+        MyContainer<int> container;
+        for (int value : {1, 3, 5, 7}) {
+            container.add(value);
+        }
+        container.update(++container.begin(), 4);
+        CHECK(container.is_sorted());
+        container.update(container.begin(), 6);
+        CHECK_FALSE(container.is_sorted());
+        container.update(container.begin(), 2);
+        CHECK(container.is_sorted());
+        container.update(container.begin(), 6);
+        CHECK_FALSE(container.is_sorted());
+        check_orders(container, {6, 4, 5, 7});
+        container.add(0);
+        container.update(++container.begin(), 9);
+        check_orders(container, {6, 9, 5, 7, 0});
+        container.add(2);
+        container.update(container.begin_reverse_order(), -5);
+        check_orders(container, {6, 9, 5, 7, 0, -5});
+    }
+}
+
+TEST_CASE("Hash index of value counts") {
+    SUBCASE("Counts follow adds and removals") {
+        MyContainer<int> container;
+        std::vector<int> mirror;
+        for (int i = 0; i < 200; ++i) {
+            container.add(i % 50 * 1024);
+            mirror.push_back(i % 50 * 1024);
+        }
+        CHECK_FALSE(container.hash_index());
+        container.enable_hash_index();
+        CHECK(container.hash_index());
+        for (int step = 0; step < 400; ++step) {
+            int value = (step * 7919) % 60 * 1024;
+            if (step % 3 == 0) {
+                container.add(value);
+                mirror.push_back(value);
+            } else if (std::count(mirror.begin(), mirror.end(), value) > 0) {
+                container.remove(value);
+                mirror.erase(std::remove(mirror.begin(), mirror.end(), value), mirror.end());
+            } else {
+                CHECK_THROWS_AS(container.remove(value), std::runtime_error);
+            }
+        }
+        for (int value = -1024; value <= 61 * 1024; value += 512) {
+            size_t expected = static_cast<size_t>(std::count(mirror.begin(), mirror.end(), value));
+            CHECK(container.count(value) == expected);
+            CHECK(container.contains(value) == (expected > 0));
+        }
+        CHECK(container.size() == mirror.size());
+
+        container.remove_if([](int x) { return x < 30 * 1024; });
+        MyContainer<int> copy(container);
+        CHECK(copy.hash_index());
+        CHECK(copy.count(10 * 1024) == 0);
+        CHECK(copy.count(40 * 1024) == static_cast<size_t>(std::count(mirror.begin(), mirror.end(), 40 * 1024)));
+        copy.disable_hash_index();
+        CHECK(copy.count(40 * 1024) == container.count(40 * 1024));
+    }
+
+    SUBCASE("Strings and comparator-defined equality") {
+        MyContainer<std::string> words;
+        words.enable_hash_index();
+        for (const char* word : {"pear", "fig", "pear", "kiwi"}) {
+            words.add(word);
+        }
+        CHECK(words.count("pear") == 2);
+        CHECK_THROWS_AS(words.remove("plum"), std::runtime_error);
+        words.remove("pear");
+        CHECK_FALSE(words.contains("pear"));
+        CHECK(words.size() == 2);
+
+        MyContainer<int, std::allocator<int>, 0, LastDigitLess> digits(LastDigitLess{10});
+        digits.enable_hash_index();
+        for (int value : {21, 11, 5}) {
+            digits.add(value);
+        }
+        CHECK(digits.count(1) == 2);  // equivalence under the comparator, not ==
+        CHECK_THROWS_AS(digits.remove(1), std::runtime_error);
+    }
+}
+
+TEST_CASE("Index-permutation orderings") {
+    MyContainer<Heavy> container;
+    for (int key : {5, 2, 8, 1, 9, 3}) {
+        container.add(Heavy(key));
+    }
+    Heavy::copies = 0;
+
+    SUBCASE("Traversals do not copy elements") {
+        std::vector<int> ascending;
+        for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); ++it) {
+            ascending.push_back(it->key);
+        }
+        std::vector<int> side_cross;
+        for (auto it = container.begin_side_cross_order(); it != container.end_side_cross_order(); ++it) {
+            side_cross.push_back(it->key);
+        }
+        std::vector<int> middle_out;
+        for (auto it = container.begin_middle_out_order(); it != container.end_middle_out_order(); ++it) {
+            middle_out.push_back(it->key);
+        }
+        int descending_sum = 0;
+        container.for_each(Order::Descending, [&](const Heavy& value) { descending_sum += value.key; });
+        CHECK(ascending == std::vector<int>{1, 2, 3, 5, 8, 9});
+        CHECK(side_cross == std::vector<int>{1, 9, 2, 8, 3, 5});
+        CHECK(middle_out == std::vector<int>{1, 8, 9, 2, 3, 5});
+        CHECK(descending_sum == 28);
+        CHECK(Heavy::copies == 0);
+    }
+
+    SUBCASE("Iterators refer to the stored elements") {
+        const Heavy* smallest = nullptr;
+        for (auto it = container.begin(); it != container.end(); ++it) {
+            if (it->key == 1) {
+                smallest = &*it;
+            }
+        }
+        CHECK(&*container.begin_ascending_order() == smallest);
+        auto it = container.begin_descending_order();
+        for (int i = 0; i < 5; ++i) {
+            ++it;
+        }
+        CHECK(&*it == smallest);
+        CHECK(Heavy::copies == 0);
+    }
+
+    SUBCASE("Copied iterators share the permutation contents") {
+        auto first = container.begin_descending_order();
+        auto second = first;
+        ++second;
+        CHECK(first->key == 9);
+        CHECK(second->key == 8);
+        CHECK(Heavy::copies == 0);
+    }
+}
+
+TEST_CASE("Prefix-key sorting of strings") {
+    // Shared prefixes, short strings, embedded zeros and non-ASCII bytes
+    std::vector<std::string> values;
+    std::string alphabet("ab\0\xff", 4);
+    for (int i = 0; i < 300; ++i) {
+        std::string value = (i % 3 == 0) ? "common-prefix-" : "";
+        for (int j = 0; j < i % 11; ++j) {
+            value += alphabet[static_cast<size_t>(i * 7 + j * 13) % alphabet.size()];
+        }
+        values.push_back(value);
+    }
+    values.push_back("");
+    values.push_back(std::string("\0", 1));
+    std::vector<std::string> expected = values;
+    std::sort(expected.begin(), expected.end());
+
+    SUBCASE("Iterators, cache and materialize") {
+        MyContainer<std::string> container;
+        for (const std::string& value : values) {
+            container.add(value);
+        }
+        std::vector<std::string> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == expected);
+        std::vector<std::string> descending(container.begin_descending_order(), container.end_descending_order());
+        CHECK(std::equal(descending.begin(), descending.end(), expected.rbegin()));
+
+        MyContainer<std::string> cold;
+        for (const std::string& value : values) {
+            cold.add(value);
+        }
+        std::vector<std::string> materialized(values.size());
+        cold.materialize(Order::Ascending, materialized.begin(), ExecutionPolicy{4, 16});
+        CHECK(materialized == expected);
+    }
+
+    SUBCASE("Transparent comparator") {
+        MyContainer<std::string, std::allocator<std::string>, 0, std::less<>> container;
+        for (const std::string& value : values) {
+            container.add(value);
+        }
+        std::vector<std::string> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == expected);
+    }
+
+    SUBCASE("Keys only apply to the default ordering") {
+        MyContainer<std::string, std::allocator<std::string>, 0, std::greater<std::string>> container;
+        for (const std::string& value : values) {
+            container.add(value);
+        }
+        std::vector<std::string> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(std::equal(ascending.begin(), ascending.end(), expected.rbegin()));
+    }
+}
+
+TEST_CASE("Counting sort for narrow integer ranges") {
+    SUBCASE("Sorted orders of a low-cardinality container") {
+        MyContainer<int> container;
+        std::vector<int> values;
+        for (int i = 0; i < 1000; ++i) {
+            values.push_back((i * 37) % 101 - 50);
+        }
+        for (int value : values) {
+            container.add(value);
+        }
+        std::vector<int> expected = values;
+        std::sort(expected.begin(), expected.end());
+        CHECK(std::vector<int>(container.begin_ascending_order(), container.end_ascending_order()) == expected);
+        CHECK(std::equal(container.begin_descending_order(), container.end_descending_order(), expected.rbegin()));
+        std::vector<int> side_cross(container.begin_side_cross_order(), container.end_side_cross_order());
+        CHECK(side_cross.front() == -50);
+        CHECK(side_cross[1] == 50);
+
+        MyContainer<int> cold;
+        for (int value : values) {
+            cold.add(value);
+        }
+        std::vector<int> materialized(values.size());
+        cold.materialize(Order::Ascending, materialized.begin());
+        CHECK(materialized == expected);
+    }
+
+    SUBCASE("Character containers, ties in insertion order") {
+        MyContainer<char> container;
+        std::string text;
+        for (int i = 0; i < 400; ++i) {
+            text += static_cast<char>('a' + (i * 7) % 26);
+        }
+        for (char c : text) {
+            container.add(c);
+        }
+        std::string sorted(container.begin_ascending_order(), container.end_ascending_order());
+        std::string expected = text;
+        std::sort(expected.begin(), expected.end());
+        CHECK(sorted == expected);
+
+        const char* previous = nullptr;
+        bool stable = true;
+        for (auto it = container.begin_ascending_order(); it != container.end_ascending_order(); ++it) {
+            stable = stable && !(previous && *previous == *it && previous > &*it);
+            previous = &*it;
+        }
+        CHECK(stable);
+    }
+
+    SUBCASE("Extreme values fall back to comparison sorting") {
+        MyContainer<long long> container;
+        for (int i = 0; i < 300; ++i) {
+            container.add(i % 2 == 0 ? std::numeric_limits<long long>::max() - i
+                                     : std::numeric_limits<long long>::lowest() + i);
+        }
+        CHECK(*container.begin_ascending_order() == std::numeric_limits<long long>::lowest() + 1);
+        CHECK(*container.begin_descending_order() == std::numeric_limits<long long>::max());
+    }
+}
+
+TEST_CASE("Adaptive sorting of presorted data") {
+    SUBCASE("is_sorted tracks appends") {
+        MyContainer<int> container;
+        CHECK(container.is_sorted());
+        container.add(1);
+        container.add(3);
+        container.add(3);
+        CHECK(container.is_sorted());
+        container.add(2);
+        CHECK_FALSE(container.is_sorted());
+        container.remove(3);
+        CHECK(container.is_sorted());
+        container.add(0);
+        CHECK_FALSE(container.is_sorted());
+        container.remove(1);
+        CHECK_FALSE(container.is_sorted());
+        container.remove(0);
+        CHECK(container.is_sorted());
+        MyContainer<int> copy(container);
+        CHECK(copy.is_sorted());
+    }
+
+    SUBCASE("is_sorted notices erase and update restoring the order") {
+        MyContainer<int> container;
+        for (int value : {1, 9, 3, 4}) {
+            container.add(value);
+        }
+        CHECK_FALSE(container.is_sorted());
+        container.erase(++container.begin());
+        CHECK(container.is_sorted());
+        container.update(container.begin(), 5);
+        CHECK_FALSE(container.is_sorted());
+        container.begin_ascending_order();
+        container.update(container.begin(), 2);
+        CHECK(container.is_sorted());
+        std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == std::vector<int>{2, 3, 4});
+        container.add(0);
+        container.remove_if([](int x) { return x == 0; });
+        CHECK(container.is_sorted());
+    }
+
+    SUBCASE("Sorted and reverse-sorted input costs O(n) comparisons") {
+        size_t comparisons = 0;
+        const size_t n = 5000;
+        CountedContainer ascending(CountingLess{&comparisons});
+        CountedContainer descending(CountingLess{&comparisons});
+        for (size_t i = 0; i < n; ++i) {
+            ascending.add(static_cast<int>(i));
+            descending.add(static_cast<int>(n - i));
+        }
+        comparisons = 0;
+        CHECK(*ascending.begin_ascending_order() == 0);
+        CHECK(comparisons == 0);
+        CHECK(*descending.begin_ascending_order() == 1);
+        CHECK(comparisons < 2 * n);
+        CHECK_FALSE(descending.is_sorted());
+    }
+
+    SUBCASE("is_sorted follows the comparator") {
+        MyContainer<int, std::allocator<int>, 0, std::greater<int>> container;
+        container.add(5);
+        container.add(4);
+        CHECK(container.is_sorted());
+        container.add(6);
+        CHECK_FALSE(container.is_sorted());
+    }
+
+    SUBCASE("Nearly sorted, reverse sorted and run-structured input") {
+        std::vector<std::vector<double>> inputs(3);
+        for (int i = 0; i < 2000; ++i) {
+            inputs[0].push_back(i == 1000 ? -1.0 : i);           // one element out of place
+            inputs[1].push_back(2000.0 - i / 2);                 // descending with ties
+            inputs[2].push_back((i % 500) + (i / 500) * 0.25);  // four ascending runs
+        }
+        for (const auto& values : inputs) {
+            MyContainer<double> container;
+            for (double value : values) {
+                container.add(value);
+            }
+            std::vector<double> expected = values;
+            std::sort(expected.begin(), expected.end());
+            std::vector<double> ascending(container.begin_ascending_order(), container.end_ascending_order());
+            CHECK(ascending == expected);
+            std::vector<double> descending(container.begin_descending_order(), container.end_descending_order());
+            CHECK(std::equal(descending.begin(), descending.end(), expected.rbegin()));
+        }
+    }
+
+    SUBCASE("Stable ordering keeps equal elements in insertion order across merged runs") {
+        struct Keyed {
+            int key;
+            int id;
+            bool operator<(const Keyed& other) const { return key < other.key; }
+        };
+        MyContainer<Keyed> keyed;
+        keyed.enable_stable_ordering();
+        for (int i = 0; i < 100; ++i) {
+            keyed.add(Keyed{i % 50, i});
+        }
+        std::vector<int> ids;
+        for (auto it = keyed.begin_ascending_order(); it != keyed.end_ascending_order(); ++it) {
+            ids.push_back(it->id);
+        }
+        CHECK(ids[0] == 0);
+        CHECK(ids[1] == 50);
+        CHECK(ids[98] == 49);
+        CHECK(ids[99] == 99);
+    }
+}
+
+TEST_CASE("Compact frame-of-reference storage") {
+    SUBCASE("Lane width follows the value range") {
+        CompactMyContainer<int> container;
+        CHECK(container.size() == 0);
+        for (int value : {700, 20, 999, 0, 512}) {
+            container.add(value);
+        }
+        CHECK(container.bytes_per_element() == 2);
+        CHECK(container.size() == 5);
+
+        CompactMyContainer<int> narrow;
+        for (int value : {-40, 100, 7}) {
+            narrow.add(value);
+        }
+        CHECK(narrow.bytes_per_element() == 1);
+        narrow.add(1 << 20);
+        CHECK(narrow.bytes_per_element() == 4);
+
+        std::ostringstream out;
+        out << narrow;
+        CHECK(out.str() == "[-40, 100, 7, 1048576]");
+    }
+
+    SUBCASE("Orders match MyContainer") {
+        CompactMyContainer<int> compact;
+        MyContainer<int> plain;
+        for (int i = 0; i < 200; ++i) {
+            int value = (i * 7919) % 1000 - 300;
+            compact.add(value);
+            plain.add(value);
+        }
+        compact.remove(-300);
+        plain.remove(-300);
+        CHECK(compact.bytes_per_element() == 2);
+        CHECK(std::vector<int>(compact.begin_ascending_order(), compact.end_ascending_order()) ==
+              std::vector<int>(plain.begin_ascending_order(), plain.end_ascending_order()));
+        CHECK(std::vector<int>(compact.begin_descending_order(), compact.end_descending_order()) ==
+              std::vector<int>(plain.begin_descending_order(), plain.end_descending_order()));
+        CHECK(std::vector<int>(compact.begin_side_cross_order(), compact.end_side_cross_order()) ==
+              std::vector<int>(plain.begin_side_cross_order(), plain.end_side_cross_order()));
+        CHECK(std::vector<int>(compact.begin_reverse_order(), compact.end_reverse_order()) ==
+              std::vector<int>(plain.begin_reverse_order(), plain.end_reverse_order()));
+        CHECK(std::vector<int>(compact.begin(), compact.end()) == std::vector<int>(plain.begin(), plain.end()));
+        CHECK(std::vector<int>(compact.begin_middle_out_order(), compact.end_middle_out_order()) ==
+              std::vector<int>(plain.begin_middle_out_order(), plain.end_middle_out_order()));
+
+        // Odd and even sizes take different tails in side cross and middle out
+        for (int extra : {0, 42}) {
+            if (extra != 0) {
+                compact.add(extra);
+                plain.add(extra);
+            }
+            for (Order order : {Order::Normal, Order::Ascending, Order::Descending, Order::SideCross,
+                                Order::Reverse, Order::MiddleOut}) {
+                std::vector<int> expected(plain.size());
+                std::vector<int> decoded(compact.size());
+                plain.materialize(order, expected.begin());
+                compact.materialize(order, decoded.begin());
+                CHECK(decoded == expected);
+            }
+        }
+    }
+
+    SUBCASE("Extreme values use the full width") {
+        CompactMyContainer<int64_t> container;
+        container.add(std::numeric_limits<int64_t>::max());
+        container.add(0);
+        container.add(std::numeric_limits<int64_t>::lowest());
+        CHECK(container.bytes_per_element() == 8);
+        std::vector<int64_t> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == std::vector<int64_t>{std::numeric_limits<int64_t>::lowest(), 0,
+                                                std::numeric_limits<int64_t>::max()});
+    }
+
+    SUBCASE("Descending inserts do not re-encode on every add") {
+        CompactMyContainer<unsigned char> container;
+        for (int value = 255; value >= 0; --value) {
+            container.add(static_cast<unsigned char>(value));
+        }
+        CHECK(container.bytes_per_element() == 1);
+        CHECK(container.reencode_count() == 0);
+        CHECK(*container.begin_ascending_order() == 0);
+        CHECK(*container.begin_descending_order() == 255);
+
+        // Every add below the base would re-encode without the spare room around the range
+        CompactMyContainer<int> wide;
+        for (int value = 10000; value >= 0; --value) {
+            wide.add(value);
+        }
+        CHECK(wide.bytes_per_element() == 2);
+        CHECK(wide.reencode_count() <= 16);
+        CHECK(*wide.begin_ascending_order() == 0);
+        CHECK(*wide.begin_descending_order() == 10000);
+    }
+
+    SUBCASE("Decoding iterators are input iterators") {
+        using Ascending = CompactMyContainer<int>::AscendingIterator;
+        static_assert(std::is_same<std::iterator_traits<Ascending>::iterator_category,
+                                   std::input_iterator_tag>::value, "");
+#if defined(__cpp_lib_ranges)
+        static_assert(std::input_iterator<Ascending>);
+#endif
+        CompactMyContainer<int> container;
+        for (int value : {3, 1, 2}) {
+            container.add(value);
+        }
+        std::vector<int> ascending(container.begin_ascending_order(), container.end_ascending_order());
+        CHECK(ascending == std::vector<int>{1, 2, 3});
+    }
+
+    SUBCASE("Removing missing elements") {
+        CompactMyContainer<int> container;
+        CHECK_THROWS_AS(container.remove(1), std::runtime_error);
+        container.add(10);
+        CHECK_THROWS_AS(container.remove(1000000), std::runtime_error);
+        CHECK_THROWS_AS(container.remove(11), std::runtime_error);
+        container.remove(10);
+        CHECK(container.size() == 0);
+        CHECK(container.begin_ascending_order() == container.end_ascending_order());
+    }
+}
+
+#ifdef ARIEL_HAS_CONSTEXPR_CONTAINER
+namespace {
+
+/// Side cross and middle out tables of constant data, computed at compile time
+constexpr std::array<int, 10> compile_time_tables() {
+    MyContainer<int> container;
+    for (int value : {7, 15, 6, 1, 2, 99}) {
+        container.add(value);
+    }
+    container.remove(99);
+    std::array<int, 10> table{};
+    size_t i = 0;
+    for (auto it = container.begin_side_cross_order(); it != container.end_side_cross_order(); ++it) {
+        table[i++] = *it;
+    }
+    for (auto it = container.begin_middle_out_order(); it != container.end_middle_out_order(); it++) {
+        table[i++] = *it;
+    }
+    return table;
+}
+
+constexpr int compile_time_descending_head() {
+    MyContainer<int> container;
+    container.add(3);
+    container.add(9);
+    container.add(4);
+    MyContainer<int> copy(container);
+    copy.remove_if([](int x) { return x > 8; });
+    return *container.begin_descending_order() * 10 + *copy.begin_descending_order();
+}
+
+/// Lookups after merging removals and additions into a warm cache
+constexpr size_t compile_time_lookups() {
+    MyContainer<int> container;
+    for (int value : {8, 3, 8, 1, 5}) {
+        container.add(value);
+    }
+    container.begin_ascending_order();
+    container.remove(3);
+    container.add(2);
+    container.add(8);
+    return container.count(8) * 100 + container.lower_bound(5) * 10 + (container.contains(3) ? 1 : 0);
+}
+
+constexpr StaticMyContainer<int, 6> make_static_table() {
+    StaticMyContainer<int, 6> container;
+    for (int value : {5, 1, 4, 2, 3}) {
+        container.add(value);
+    }
+    return container;
+}
+
+constexpr auto static_table = make_static_table();
+
+} // namespace
+
+TEST_CASE("Compile-time order generation") {
+    static_assert(compile_time_tables() == std::array<int, 10>{1, 15, 2, 7, 6, 6, 15, 1, 7, 2});
+    static_assert(compile_time_descending_head() == 94);
+    static_assert(compile_time_lookups() == 320);
+    static_assert(*static_table.begin_side_cross_order() == 1);
+    static_assert(*++static_table.begin_side_cross_order() == 5);
+    static_assert(*static_table.begin_middle_out_order() == 4);
+    static_assert(static_table.size() == 5);
+    CHECK(compile_time_tables()[0] == 1);
+}
+#endif